@@ -1,5 +1,6 @@
 #include <gbm.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -24,16 +25,21 @@ static void atomic_begin(struct atomic *atom) {
 }
 
 static bool atomic_commit(struct atomic *atom,
-		struct wlr_drm_connector *conn, uint32_t flags) {
+		struct wlr_drm_connector *conn, struct wlr_drm_crtc *crtc,
+		uint32_t flags) {
 	struct wlr_drm_backend *drm =
 		get_drm_backend_from_backend(conn->output.backend);
 	if (atom->failed) {
 		return false;
 	}
 
-	int ret = drmModeAtomicCommit(drm->fd, atom->req, flags, drm);
+	// The page-flip event is delivered with the CRTC
+	int ret = drmModeAtomicCommit(drm->fd, atom->req, flags, crtc);
 	if (ret) {
-		wlr_log_errno(WLR_ERROR, "%s: Atomic %s failed (%s)",
+		// Failing tests are expected, e.g. when assigning overlay planes
+		enum wlr_log_importance importance =
+			(flags & DRM_MODE_ATOMIC_TEST_ONLY) ? WLR_DEBUG : WLR_ERROR;
+		wlr_log_errno(importance, "%s: Atomic %s failed (%s)",
 			conn->output.name,
 			(flags & DRM_MODE_ATOMIC_TEST_ONLY) ? "test" : "commit",
 			(flags & DRM_MODE_ATOMIC_ALLOW_MODESET) ? "modeset" : "pageflip");
@@ -132,10 +138,10 @@ static void plane_disable(struct atomic *atom, struct wlr_drm_plane *plane) {
 }
 
 static void set_plane_props(struct atomic *atom, struct wlr_drm_backend *drm,
-		struct wlr_drm_plane *plane, uint32_t crtc_id, int32_t x, int32_t y) {
+		struct wlr_drm_plane *plane, struct wlr_drm_fb *fb, uint32_t crtc_id,
+		const struct wlr_box *dst) {
 	uint32_t id = plane->id;
 	const union wlr_drm_plane_props *props = &plane->props;
-	struct wlr_drm_fb *fb = plane_get_next_fb(plane);
 	struct gbm_bo *bo = drm_fb_acquire(fb, drm, &plane->mgpu_surf);
 	if (!bo) {
 		goto error;
@@ -149,14 +155,22 @@ static void set_plane_props(struct atomic *atom, struct wlr_drm_backend *drm,
 	// The src_* properties are in 16.16 fixed point
 	atomic_add(atom, id, props->src_x, 0);
 	atomic_add(atom, id, props->src_y, 0);
-	atomic_add(atom, id, props->src_w, (uint64_t)plane->surf.width << 16);
-	atomic_add(atom, id, props->src_h, (uint64_t)plane->surf.height << 16);
-	atomic_add(atom, id, props->crtc_w, plane->surf.width);
-	atomic_add(atom, id, props->crtc_h, plane->surf.height);
+	atomic_add(atom, id, props->src_w, (uint64_t)gbm_bo_get_width(bo) << 16);
+	atomic_add(atom, id, props->src_h, (uint64_t)gbm_bo_get_height(bo) << 16);
+	atomic_add(atom, id, props->crtc_w, (uint64_t)dst->width);
+	atomic_add(atom, id, props->crtc_h, (uint64_t)dst->height);
 	atomic_add(atom, id, props->fb_id, fb_id);
 	atomic_add(atom, id, props->crtc_id, crtc_id);
-	atomic_add(atom, id, props->crtc_x, (uint64_t)x);
-	atomic_add(atom, id, props->crtc_y, (uint64_t)y);
+	atomic_add(atom, id, props->crtc_x, (uint64_t)dst->x);
+	atomic_add(atom, id, props->crtc_y, (uint64_t)dst->y);
+
+	// The fence covers the rendering of fb->bo. With multiple GPUs, it
+	// still applies when the buffer is imported directly, but not when
+	// the scanned out buffer is a copy, which has no fence.
+	if (props->in_fence_fd != 0 && fb->mgpu_surf == NULL &&
+			fb->type == WLR_DRM_FB_TYPE_SURFACE && fb->in_fence_fd >= 0) {
+		atomic_add(atom, id, props->in_fence_fd, fb->in_fence_fd);
+	}
 
 	return;
 
@@ -165,6 +179,25 @@ error:
 	atom->failed = true;
 }
 
+static void set_overlay_props(struct atomic *atom, struct wlr_drm_backend *drm,
+		struct wlr_drm_crtc *crtc, struct wlr_drm_plane *overlay) {
+	// Unless a new frame is being submitted or tested, keep the overlay as
+	// it is: the pending framebuffer is only a proposal until then
+	struct wlr_drm_fb *fb;
+	if (crtc->overlays_pending) {
+		fb = &overlay->pending_fb;
+	} else if (overlay->queued_fb.type != WLR_DRM_FB_TYPE_NONE) {
+		fb = &overlay->queued_fb;
+	} else {
+		fb = &overlay->current_fb;
+	}
+	if (fb->type == WLR_DRM_FB_TYPE_NONE) {
+		plane_disable(atom, overlay);
+		return;
+	}
+	set_plane_props(atom, drm, overlay, fb, crtc->id, &overlay->overlay_dst);
+}
+
 static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 		struct wlr_drm_connector *conn, uint32_t flags) {
 	struct wlr_output *output = &conn->output;
@@ -210,14 +243,21 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 		flags |= DRM_MODE_ATOMIC_NONBLOCK;
 	}
 
+	// Written by the kernel on commit
+	int32_t out_fence_fd = -1;
+
 	struct atomic atom;
 	atomic_begin(&atom);
-	atomic_add(&atom, conn->id, conn->props.crtc_id,
-		crtc->pending.active ? crtc->id : 0);
-	if (crtc->pending_modeset && crtc->pending.active &&
-			conn->props.link_status != 0) {
-		atomic_add(&atom, conn->id, conn->props.link_status,
-			DRM_MODE_LINK_STATUS_GOOD);
+	// Connector properties only change with a modeset. Leaving them out of
+	// page-flips keeps the commit from waiting on the connection mutex,
+	// which the scan thread may hold while reading an EDID.
+	if (crtc->pending_modeset) {
+		atomic_add(&atom, conn->id, conn->props.crtc_id,
+			crtc->pending.active ? crtc->id : 0);
+		if (crtc->pending.active && conn->props.link_status != 0) {
+			atomic_add(&atom, conn->id, conn->props.link_status,
+				DRM_MODE_LINK_STATUS_GOOD);
+		}
 	}
 	atomic_add(&atom, crtc->id, crtc->props.mode_id, mode_id);
 	atomic_add(&atom, crtc->id, crtc->props.active, crtc->pending.active);
@@ -228,29 +268,56 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 		if (crtc->props.vrr_enabled != 0) {
 			atomic_add(&atom, crtc->id, crtc->props.vrr_enabled, vrr_enabled);
 		}
-		set_plane_props(&atom, drm, crtc->primary, crtc->id, 0, 0);
+		if (crtc->props.out_fence_ptr != 0 &&
+				!(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
+			atomic_add(&atom, crtc->id, crtc->props.out_fence_ptr,
+				(uint64_t)(uintptr_t)&out_fence_fd);
+		}
+		struct wlr_box primary_box = {
+			.width = crtc->primary->surf.width,
+			.height = crtc->primary->surf.height,
+		};
+		set_plane_props(&atom, drm, crtc->primary,
+			plane_get_next_fb(crtc->primary), crtc->id, &primary_box);
+		for (size_t i = 0; i < crtc->num_overlays; ++i) {
+			set_overlay_props(&atom, drm, crtc, crtc->overlays[i]);
+		}
 		if (crtc->cursor) {
 			if (drm_connector_is_cursor_visible(conn)) {
-				set_plane_props(&atom, drm, crtc->cursor, crtc->id,
-					conn->cursor_x, conn->cursor_y);
+				struct wlr_box cursor_box = {
+					.x = conn->cursor_x,
+					.y = conn->cursor_y,
+					.width = crtc->cursor->surf.width,
+					.height = crtc->cursor->surf.height,
+				};
+				set_plane_props(&atom, drm, crtc->cursor,
+					plane_get_next_fb(crtc->cursor), crtc->id, &cursor_box);
 			} else {
 				plane_disable(&atom, crtc->cursor);
 			}
 		}
 	} else {
 		plane_disable(&atom, crtc->primary);
+		for (size_t i = 0; i < crtc->num_overlays; ++i) {
+			plane_disable(&atom, crtc->overlays[i]);
+		}
 		if (crtc->cursor) {
 			plane_disable(&atom, crtc->cursor);
 		}
 	}
 
-	bool ok = atomic_commit(&atom, conn, flags);
+	bool ok = atomic_commit(&atom, conn, crtc, flags);
 	atomic_finish(&atom);
 
 	if (ok && !(flags & DRM_MODE_ATOMIC_TEST_ONLY)) {
 		commit_blob(drm, &crtc->mode_id, mode_id);
 		commit_blob(drm, &crtc->gamma_lut, gamma_lut);
 
+		if (conn->out_fence_fd >= 0) {
+			close(conn->out_fence_fd);
+		}
+		conn->out_fence_fd = out_fence_fd;
+
 		if (vrr_enabled != prev_vrr_enabled) {
 			output->adaptive_sync_status = vrr_enabled ?
 				WLR_OUTPUT_ADAPTIVE_SYNC_ENABLED :
@@ -261,6 +328,10 @@ static bool atomic_crtc_commit(struct wlr_drm_backend *drm,
 	} else {
 		rollback_blob(drm, &crtc->mode_id, mode_id);
 		rollback_blob(drm, &crtc->gamma_lut, gamma_lut);
+
+		if (out_fence_fd >= 0) {
+			close(out_fence_fd);
+		}
 	}
 
 	return ok;
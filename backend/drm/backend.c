@@ -34,6 +34,7 @@ static void backend_destroy(struct wlr_backend *backend) {
 
 	struct wlr_drm_backend *drm = get_drm_backend_from_backend(backend);
 
+	finish_drm_scan(drm);
 	restore_drm_outputs(drm);
 
 	struct wlr_drm_connector *conn, *next;
@@ -112,7 +113,7 @@ static void drm_invalidated(struct wl_listener *listener, void *data) {
 	wlr_log(WLR_DEBUG, "%s invalidated", name);
 	free(name);
 
-	scan_drm_connectors(drm);
+	scan_drm_connectors_async(drm);
 }
 
 static void handle_session_destroy(struct wl_listener *listener, void *data) {
@@ -3,16 +3,19 @@
 #include <drm_fourcc.h>
 #include <drm_mode.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <gbm.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <strings.h>
 #include <time.h>
+#include <unistd.h>
 #include <wayland-server-core.h>
 #include <wayland-util.h>
 #include <wlr/backend/interface.h>
@@ -156,6 +159,17 @@ static bool add_plane(struct wlr_drm_backend *drm,
 	case DRM_PLANE_TYPE_CURSOR:
 		crtc->cursor = p;
 		break;
+	case DRM_PLANE_TYPE_OVERLAY:;
+		struct wlr_drm_plane **overlays = realloc(crtc->overlays,
+			sizeof(*crtc->overlays) * (crtc->num_overlays + 1));
+		if (!overlays) {
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			wlr_drm_format_set_finish(&p->formats);
+			goto error;
+		}
+		crtc->overlays = overlays;
+		crtc->overlays[crtc->num_overlays++] = p;
+		break;
 	default:
 		abort();
 	}
@@ -186,7 +200,7 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 		}
 
 		union wlr_drm_plane_props props = {0};
-		if (!get_drm_plane_props(drm->fd, id, &props)) {
+		if (!get_drm_plane_props(drm->fd, &drm->prop_cache, id, &props)) {
 			drmModeFreePlane(plane);
 			goto error;
 		}
@@ -204,9 +218,9 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 		 * overlay planes can potentially work with multiple CRTCs,
 		 * meaning this could return inefficient/skewed results.
 		 *
-		 * However, we don't really care about overlay planes, as we
-		 * don't support them yet. We only bother to keep basic
-		 * tracking of them for DRM lease clients.
+		 * Each overlay plane is only ever used by the first CRTC it
+		 * supports, so that two CRTCs never compete for it. Planes are
+		 * listed by the kernel in stacking order.
 		 *
 		 * possible_crtcs is a bitmask of crtcs, where each bit is an
 		 * index into drmModeRes.crtcs. So if bit 0 is set (ffs starts
@@ -219,17 +233,6 @@ static bool init_planes(struct wlr_drm_backend *drm) {
 
 		struct wlr_drm_crtc *crtc = &drm->crtcs[crtc_bit];
 
-		if (type == DRM_PLANE_TYPE_OVERLAY) {
-			uint32_t *tmp = realloc(crtc->overlays,
-				sizeof(*crtc->overlays) * (crtc->num_overlays + 1));
-			if (tmp) {
-				crtc->overlays = tmp;
-				crtc->overlays[crtc->num_overlays++] = id;
-			}
-			drmModeFreePlane(plane);
-			continue;
-		}
-
 		if (!add_plane(drm, crtc, plane, type, &props)) {
 			drmModeFreePlane(plane);
 			goto error;
@@ -271,7 +274,8 @@ bool init_drm_resources(struct wlr_drm_backend *drm) {
 		struct wlr_drm_crtc *crtc = &drm->crtcs[i];
 		crtc->id = res->crtcs[i];
 		crtc->legacy_crtc = drmModeGetCrtc(drm->fd, crtc->id);
-		get_drm_crtc_props(drm->fd, crtc->id, &crtc->props);
+		get_drm_crtc_props(drm->fd, &drm->prop_cache, crtc->id,
+			&crtc->props);
 	}
 
 	if (!init_planes(drm)) {
@@ -314,10 +318,15 @@ void finish_drm_resources(struct wlr_drm_backend *drm) {
 			wlr_drm_format_set_finish(&crtc->cursor->formats);
 			free(crtc->cursor);
 		}
+		for (size_t j = 0; j < crtc->num_overlays; ++j) {
+			wlr_drm_format_set_finish(&crtc->overlays[j]->formats);
+			free(crtc->overlays[j]);
+		}
 		free(crtc->overlays);
 	}
 
 	free(drm->crtcs);
+	finish_drm_prop_cache(&drm->prop_cache);
 }
 
 static struct wlr_drm_connector *get_drm_connector_from_output(
@@ -326,6 +335,27 @@ static struct wlr_drm_connector *get_drm_connector_from_output(
 	return (struct wlr_drm_connector *)wlr_output;
 }
 
+static void drm_connector_set_crtc(struct wlr_drm_connector *conn,
+		struct wlr_drm_crtc *crtc) {
+	if (conn->crtc != NULL && conn->crtc->conn == conn) {
+		conn->crtc->conn = NULL;
+	}
+	conn->crtc = crtc;
+	if (crtc != NULL) {
+		crtc->conn = conn;
+	}
+}
+
+static struct wlr_drm_crtc *get_drm_crtc_from_id(struct wlr_drm_backend *drm,
+		uint32_t crtc_id) {
+	for (size_t i = 0; i < drm->num_crtcs; ++i) {
+		if (drm->crtcs[i].id == crtc_id) {
+			return &drm->crtcs[i];
+		}
+	}
+	return NULL;
+}
+
 static bool drm_connector_attach_render(struct wlr_output *output,
 		int *buffer_age) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
@@ -343,14 +373,27 @@ static bool drm_crtc_commit(struct wlr_drm_connector *conn, uint32_t flags) {
 		if (crtc->cursor != NULL) {
 			drm_fb_move(&crtc->cursor->queued_fb, &crtc->cursor->pending_fb);
 		}
+		if (crtc->overlays_pending) {
+			for (size_t i = 0; i < crtc->num_overlays; ++i) {
+				struct wlr_drm_plane *overlay = crtc->overlays[i];
+				drm_fb_move(&overlay->queued_fb, &overlay->pending_fb);
+			}
+		}
 	} else {
 		memcpy(&crtc->pending, &crtc->current, sizeof(struct wlr_drm_crtc_state));
 		drm_fb_clear(&crtc->primary->pending_fb);
 		if (crtc->cursor != NULL) {
 			drm_fb_clear(&crtc->cursor->pending_fb);
 		}
+		// Other commits didn't use the proposed overlays
+		if (crtc->overlays_pending) {
+			for (size_t i = 0; i < crtc->num_overlays; ++i) {
+				drm_fb_clear(&crtc->overlays[i]->pending_fb);
+			}
+		}
 	}
 	crtc->pending_modeset = false;
+	crtc->overlays_pending = false;
 	return ok;
 }
 
@@ -369,6 +412,8 @@ static bool drm_crtc_page_flip(struct wlr_drm_connector *conn) {
 
 	assert(crtc->pending.active);
 	assert(plane_get_next_fb(crtc->primary)->type != WLR_DRM_FB_TYPE_NONE);
+	// Overlays which haven't been proposed for this frame are disabled
+	crtc->overlays_pending = true;
 	if (!drm_crtc_commit(conn, DRM_MODE_PAGE_FLIP_EVENT)) {
 		return false;
 	}
@@ -1024,6 +1069,7 @@ static void drm_connector_destroy(struct wlr_output *output) {
 	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
 	drm_connector_cleanup(conn);
 	drmModeFreeCrtc(conn->old_crtc);
+	drm_connector_set_crtc(conn, NULL);
 	wl_list_remove(&conn->link);
 	free(conn);
 }
@@ -1044,6 +1090,98 @@ bool wlr_output_is_drm(struct wlr_output *output) {
 	return output->impl == &output_impl;
 }
 
+int wlr_drm_connector_dup_out_fence(struct wlr_output *output) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	if (conn->out_fence_fd < 0) {
+		return -1;
+	}
+
+	int fd = fcntl(conn->out_fence_fd, F_DUPFD_CLOEXEC, 0);
+	if (fd < 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to duplicate out fence");
+	}
+	return fd;
+}
+
+static bool test_overlay(struct wlr_drm_connector *conn,
+		struct wlr_drm_plane *plane, const struct wlr_drm_overlay *overlay) {
+	struct wlr_drm_backend *drm =
+		get_drm_backend_from_backend(conn->output.backend);
+
+	struct wlr_dmabuf_attributes attribs;
+	if (!wlr_buffer_get_dmabuf(overlay->buffer, &attribs) ||
+			attribs.flags != 0) {
+		return false;
+	}
+
+	if (!drm_fb_import_wlr(&plane->pending_fb, &drm->renderer,
+			overlay->buffer, &plane->formats)) {
+		return false;
+	}
+	plane->overlay_dst = overlay->dst;
+
+	// The overlays already accepted are part of the test
+	if (!drm->iface->crtc_commit(drm, conn, DRM_MODE_ATOMIC_TEST_ONLY)) {
+		drm_fb_clear(&plane->pending_fb);
+		return false;
+	}
+
+	return true;
+}
+
+size_t wlr_drm_connector_test_overlays(struct wlr_output *output,
+		struct wlr_drm_overlay *overlays, size_t overlays_len) {
+	struct wlr_drm_connector *conn = get_drm_connector_from_output(output);
+	struct wlr_drm_backend *drm = get_drm_backend_from_backend(output->backend);
+	struct wlr_drm_crtc *crtc = conn->crtc;
+
+	for (size_t i = 0; i < overlays_len; ++i) {
+		overlays[i].accepted = false;
+	}
+
+	if (crtc == NULL) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < crtc->num_overlays; ++i) {
+		drm_fb_clear(&crtc->overlays[i]->pending_fb);
+	}
+
+	// With multiple GPUs, buffers would need to be copied anyway
+	if (!drm->session->active || drm->iface == &legacy_iface ||
+			drm->parent || !crtc->current.active) {
+		return 0;
+	}
+
+	// The proposal is only applied by the next page-flip, other commits
+	// until then keep the current overlays
+	crtc->overlays_pending = true;
+
+	size_t accepted = 0;
+	size_t plane_idx = crtc->num_overlays;
+	for (size_t i = overlays_len; i-- > 0;) {
+		struct wlr_drm_overlay *overlay = &overlays[i];
+		if (overlay->dst.width <= 0 || overlay->dst.height <= 0) {
+			break;
+		}
+
+		while (plane_idx > 0 && !overlay->accepted) {
+			struct wlr_drm_plane *plane = crtc->overlays[--plane_idx];
+			overlay->accepted = test_overlay(conn, plane, overlay);
+		}
+		if (!overlay->accepted) {
+			break;
+		}
+		accepted++;
+	}
+
+	crtc->overlays_pending = false;
+
+	wlr_log(WLR_DEBUG, "%s: %zu/%zu overlays accepted", output->name,
+		accepted, overlays_len);
+	return accepted;
+}
+
 static const int32_t subpixel_map[] = {
 	[DRM_MODE_SUBPIXEL_UNKNOWN] = WL_OUTPUT_SUBPIXEL_UNKNOWN,
 	[DRM_MODE_SUBPIXEL_HORIZONTAL_RGB] = WL_OUTPUT_SUBPIXEL_HORIZONTAL_RGB,
@@ -1071,11 +1209,14 @@ static void dealloc_crtc(struct wlr_drm_connector *conn) {
 
 	drm_plane_finish_surface(conn->crtc->primary);
 	drm_plane_finish_surface(conn->crtc->cursor);
+	for (size_t i = 0; i < conn->crtc->num_overlays; ++i) {
+		drm_plane_finish_surface(conn->crtc->overlays[i]);
+	}
 	if (conn->crtc->cursor != NULL) {
 		conn->crtc->cursor->cursor_enabled = false;
 	}
 
-	conn->crtc = NULL;
+	drm_connector_set_crtc(conn, NULL);
 }
 
 static void realloc_crtcs(struct wlr_drm_backend *drm) {
@@ -1186,7 +1327,7 @@ static void realloc_crtcs(struct wlr_drm_backend *drm) {
 			continue;
 		}
 
-		conn->crtc = &drm->crtcs[connector_match[i]];
+		drm_connector_set_crtc(conn, &drm->crtcs[connector_match[i]]);
 
 		// Only realloc buffers if we have actually been modeset
 		if (conn->state != WLR_DRM_CONN_CONNECTED) {
@@ -1245,22 +1386,184 @@ static uint32_t get_possible_crtcs(int fd, drmModeRes *res,
 	return ret;
 }
 
-void scan_drm_connectors(struct wlr_drm_backend *drm) {
-	/*
-	 * This GPU is not really a modesetting device.
-	 * It's just being used as a renderer.
-	 */
-	if (drm->num_crtcs == 0) {
+/*
+ * Reading a connector can force the kernel to probe the display, including
+ * reading its EDID over DDC, which is slow. On hotplug, this is done on a
+ * worker thread so that the outputs already enabled keep being rendered to.
+ */
+struct wlr_drm_connector_probe {
+	drmModeConnector *drm_conn;
+	drmModeEncoder *curr_enc;
+
+	// Only read by the worker when the EDID property id is already known
+	bool has_edid;
+	uint8_t *edid;
+	size_t edid_len;
+};
+
+struct wlr_drm_scan {
+	int fd;
+	uint32_t edid_prop;
+
+	drmModeRes *res;
+	size_t probes_len;
+	struct wlr_drm_connector_probe *probes;
+	// Whether probe_connectors succeeded, set by the scan thread
+	bool ok;
+
+	pthread_t thread;
+	int done_fds[2];
+	struct wl_event_source *done_event;
+};
+
+static void read_probe_edid(int fd, uint32_t edid_prop,
+		struct wlr_drm_connector_probe *probe) {
+	drmModeConnector *drm_conn = probe->drm_conn;
+	if (edid_prop == 0 || drm_conn->connection != DRM_MODE_CONNECTED) {
 		return;
 	}
 
-	wlr_log(WLR_INFO, "Scanning DRM connectors");
+	for (int i = 0; i < drm_conn->count_props; ++i) {
+		if (drm_conn->props[i] != edid_prop) {
+			continue;
+		}
 
-	drmModeRes *res = drmModeGetResources(drm->fd);
-	if (!res) {
+		probe->has_edid = true;
+		drmModePropertyBlobRes *blob =
+			drmModeGetPropertyBlob(fd, drm_conn->prop_values[i]);
+		if (!blob) {
+			return;
+		}
+		probe->edid = malloc(blob->length);
+		if (probe->edid) {
+			memcpy(probe->edid, blob->data, blob->length);
+			probe->edid_len = blob->length;
+		}
+		drmModeFreePropertyBlob(blob);
+		return;
+	}
+}
+
+// Safe to call from any thread, only the DRM fd is used
+static bool probe_connectors(struct wlr_drm_scan *scan) {
+	scan->res = drmModeGetResources(scan->fd);
+	if (!scan->res) {
 		wlr_log_errno(WLR_ERROR, "Failed to get DRM resources");
+		return false;
+	}
+
+	scan->probes = calloc(scan->res->count_connectors, sizeof(*scan->probes));
+	if (scan->res->count_connectors > 0 && !scan->probes) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	scan->probes_len = scan->res->count_connectors;
+
+	for (size_t i = 0; i < scan->probes_len; ++i) {
+		struct wlr_drm_connector_probe *probe = &scan->probes[i];
+		probe->drm_conn = drmModeGetConnector(scan->fd,
+			scan->res->connectors[i]);
+		if (!probe->drm_conn) {
+			wlr_log_errno(WLR_ERROR, "Failed to get DRM connector");
+			continue;
+		}
+		probe->curr_enc = drmModeGetEncoder(scan->fd,
+			probe->drm_conn->encoder_id);
+		read_probe_edid(scan->fd, scan->edid_prop, probe);
+	}
+
+	return true;
+}
+
+static void destroy_scan(struct wlr_drm_scan *scan) {
+	for (size_t i = 0; i < scan->probes_len; ++i) {
+		struct wlr_drm_connector_probe *probe = &scan->probes[i];
+		drmModeFreeEncoder(probe->curr_enc);
+		drmModeFreeConnector(probe->drm_conn);
+		free(probe->edid);
+	}
+	free(scan->probes);
+	drmModeFreeResources(scan->res);
+
+	if (scan->done_event) {
+		wl_event_source_remove(scan->done_event);
+	}
+	if (scan->done_fds[0] >= 0) {
+		close(scan->done_fds[0]);
+		close(scan->done_fds[1]);
+	}
+	free(scan);
+}
+
+static struct wlr_drm_scan *create_scan(struct wlr_drm_backend *drm) {
+	struct wlr_drm_scan *scan = calloc(1, sizeof(*scan));
+	if (!scan) {
+		wlr_log_errno(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	scan->fd = drm->fd;
+	scan->done_fds[0] = scan->done_fds[1] = -1;
+
+	// The EDID property is shared by all connectors of a device
+	struct wlr_drm_connector *conn;
+	wl_list_for_each(conn, &drm->outputs, link) {
+		if (conn->props.edid != 0) {
+			scan->edid_prop = conn->props.edid;
+			break;
+		}
+	}
+
+	return scan;
+}
+
+void finish_drm_scan(struct wlr_drm_backend *drm) {
+	if (drm->scan == NULL) {
+		return;
+	}
+
+	pthread_join(drm->scan->thread, NULL);
+	destroy_scan(drm->scan);
+	drm->scan = NULL;
+	drm->scan_again = false;
+}
+
+static void connector_update_crtc(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn, drmModeEncoder *enc) {
+	if (!enc) {
+		drm_connector_set_crtc(conn, NULL);
+		return;
+	}
+
+	struct wlr_drm_crtc *crtc = get_drm_crtc_from_id(drm, enc->crtc_id);
+	// Never take over the CRTC of another connector, it would stop
+	// receiving its page-flip events
+	if (crtc != NULL && (crtc->conn == NULL || crtc->conn == conn)) {
+		drm_connector_set_crtc(conn, crtc);
+	}
+}
+
+/**
+ * Re-read the encoder currently driving the connector. The encoder probed by
+ * the scan thread may be stale: the compositor can modeset the connector and
+ * realloc_crtcs can move it to another CRTC in the meantime.
+ */
+static void connector_refresh_crtc(struct wlr_drm_backend *drm,
+		struct wlr_drm_connector *conn) {
+	// Doesn't force a probe of the display, unlike drmModeGetConnector
+	drmModeConnector *drm_conn = drmModeGetConnectorCurrent(drm->fd, conn->id);
+	if (!drm_conn) {
+		wlr_log_errno(WLR_ERROR, "Failed to get DRM connector");
 		return;
 	}
+	drmModeEncoder *enc = drmModeGetEncoder(drm->fd, drm_conn->encoder_id);
+	connector_update_crtc(drm, conn, enc);
+	drmModeFreeEncoder(enc);
+	drmModeFreeConnector(drm_conn);
+}
+
+static void apply_scan(struct wlr_drm_backend *drm,
+		struct wlr_drm_scan *scan) {
+	drmModeRes *res = scan->res;
 
 	size_t seen_len = wl_list_length(&drm->outputs);
 	// +1 so length can never be 0, which is undefined behaviour.
@@ -1270,15 +1573,13 @@ void scan_drm_connectors(struct wlr_drm_backend *drm) {
 	size_t new_outputs_len = 0;
 	struct wlr_drm_connector *new_outputs[res->count_connectors + 1];
 
-	for (int i = 0; i < res->count_connectors; ++i) {
-		drmModeConnector *drm_conn = drmModeGetConnector(drm->fd,
-			res->connectors[i]);
+	for (size_t i = 0; i < scan->probes_len; ++i) {
+		struct wlr_drm_connector_probe *probe = &scan->probes[i];
+		drmModeConnector *drm_conn = probe->drm_conn;
 		if (!drm_conn) {
-			wlr_log_errno(WLR_ERROR, "Failed to get DRM connector");
 			continue;
 		}
-		drmModeEncoder *curr_enc = drmModeGetEncoder(drm->fd,
-			drm_conn->encoder_id);
+		drmModeEncoder *curr_enc = probe->curr_enc;
 
 		ssize_t index = -1;
 		struct wlr_drm_connector *c, *wlr_conn = NULL;
@@ -1294,8 +1595,6 @@ void scan_drm_connectors(struct wlr_drm_backend *drm) {
 			wlr_conn = calloc(1, sizeof(*wlr_conn));
 			if (!wlr_conn) {
 				wlr_log_errno(WLR_ERROR, "Allocation failed");
-				drmModeFreeEncoder(curr_enc);
-				drmModeFreeConnector(drm_conn);
 				continue;
 			}
 			wlr_output_init(&wlr_conn->output, &drm->backend, &output_impl,
@@ -1303,6 +1602,7 @@ void scan_drm_connectors(struct wlr_drm_backend *drm) {
 
 			wlr_conn->state = WLR_DRM_CONN_DISCONNECTED;
 			wlr_conn->id = drm_conn->connector_id;
+			wlr_conn->out_fence_fd = -1;
 
 			snprintf(wlr_conn->output.name, sizeof(wlr_conn->output.name),
 				"%s-%"PRIu32, conn_get_name(drm_conn->connector_type),
@@ -1318,15 +1618,11 @@ void scan_drm_connectors(struct wlr_drm_backend *drm) {
 			seen[index] = true;
 		}
 
-		if (curr_enc) {
-			for (size_t i = 0; i < drm->num_crtcs; ++i) {
-				if (drm->crtcs[i].id == curr_enc->crtc_id) {
-					wlr_conn->crtc = &drm->crtcs[i];
-					break;
-				}
-			}
+		if (wlr_conn->state == WLR_DRM_CONN_DISCONNECTED) {
+			// Includes the connectors created by this scan
+			connector_update_crtc(drm, wlr_conn, curr_enc);
 		} else {
-			wlr_conn->crtc = NULL;
+			connector_refresh_crtc(drm, wlr_conn);
 		}
 
 		// This can only happen *after* hotplug, since we haven't read the
@@ -1359,11 +1655,19 @@ void scan_drm_connectors(struct wlr_drm_backend *drm) {
 				wlr_conn->output.phys_width, wlr_conn->output.phys_height);
 			wlr_conn->output.subpixel = subpixel_map[drm_conn->subpixel];
 
-			get_drm_connector_props(drm->fd, wlr_conn->id, &wlr_conn->props);
+			get_drm_connector_props(drm->fd, &drm->prop_cache,
+				wlr_conn->id, &wlr_conn->props);
 
 			size_t edid_len = 0;
-			uint8_t *edid = get_drm_prop_blob(drm->fd,
-				wlr_conn->id, wlr_conn->props.edid, &edid_len);
+			uint8_t *edid = NULL;
+			if (probe->has_edid) {
+				edid = probe->edid;
+				edid_len = probe->edid_len;
+				probe->edid = NULL;
+			} else {
+				edid = get_drm_prop_blob(drm->fd,
+					wlr_conn->id, wlr_conn->props.edid, &edid_len);
+			}
 			parse_edid(&wlr_conn->output, edid_len, edid);
 			free(edid);
 
@@ -1433,13 +1737,8 @@ void scan_drm_connectors(struct wlr_drm_backend *drm) {
 
 			drm_connector_cleanup(wlr_conn);
 		}
-
-		drmModeFreeEncoder(curr_enc);
-		drmModeFreeConnector(drm_conn);
 	}
 
-	drmModeFreeResources(res);
-
 	// Iterate in reverse order because we'll remove items from the list and
 	// still want indices to remain correct.
 	struct wlr_drm_connector *conn, *tmp_conn;
@@ -1470,26 +1769,126 @@ void scan_drm_connectors(struct wlr_drm_backend *drm) {
 	attempt_enable_needs_modeset(drm);
 }
 
+void scan_drm_connectors(struct wlr_drm_backend *drm) {
+	/*
+	 * This GPU is not really a modesetting device.
+	 * It's just being used as a renderer.
+	 */
+	if (drm->num_crtcs == 0) {
+		return;
+	}
+
+	// Results of an asynchronous scan would be stale
+	finish_drm_scan(drm);
+
+	wlr_log(WLR_INFO, "Scanning DRM connectors");
+
+	struct wlr_drm_scan *scan = create_scan(drm);
+	if (!scan) {
+		return;
+	}
+
+	if (probe_connectors(scan)) {
+		apply_scan(drm, scan);
+	}
+	destroy_scan(scan);
+}
+
+static void *scan_thread(void *data) {
+	struct wlr_drm_scan *scan = data;
+	scan->ok = probe_connectors(scan);
+
+	// Wake up the event loop, the result is read from the scan itself
+	char byte = 0;
+	while (write(scan->done_fds[1], &byte, 1) < 0 && errno == EINTR) {
+		// Retry
+	}
+	return NULL;
+}
+
+static int handle_scan_done(int fd, uint32_t mask, void *data) {
+	struct wlr_drm_backend *drm = data;
+	struct wlr_drm_scan *scan = drm->scan;
+
+	pthread_join(scan->thread, NULL);
+	drm->scan = NULL;
+
+	if (scan->ok) {
+		apply_scan(drm, scan);
+	}
+	destroy_scan(scan);
+
+	// Connectors changed again while probing
+	if (drm->scan_again) {
+		drm->scan_again = false;
+		scan_drm_connectors_async(drm);
+	}
+
+	return 0;
+}
+
+void scan_drm_connectors_async(struct wlr_drm_backend *drm) {
+	if (drm->num_crtcs == 0) {
+		return;
+	}
+
+	if (drm->scan != NULL) {
+		drm->scan_again = true;
+		return;
+	}
+
+	wlr_log(WLR_INFO, "Scanning DRM connectors in the background");
+
+	struct wlr_drm_scan *scan = create_scan(drm);
+	if (!scan) {
+		return;
+	}
+
+	if (pipe(scan->done_fds) != 0) {
+		wlr_log_errno(WLR_ERROR, "Failed to create pipe");
+		scan->done_fds[0] = scan->done_fds[1] = -1;
+		goto error;
+	}
+	for (size_t i = 0; i < 2; ++i) {
+		fcntl(scan->done_fds[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	struct wl_event_loop *event_loop = wl_display_get_event_loop(drm->display);
+	scan->done_event = wl_event_loop_add_fd(event_loop, scan->done_fds[0],
+		WL_EVENT_READABLE, handle_scan_done, drm);
+	if (!scan->done_event) {
+		wlr_log(WLR_ERROR, "Failed to create scan event source");
+		goto error;
+	}
+
+	if (pthread_create(&scan->thread, NULL, scan_thread, scan) != 0) {
+		wlr_log(WLR_ERROR, "Failed to create scan thread");
+		goto error;
+	}
+
+	drm->scan = scan;
+	return;
+
+error:
+	destroy_scan(scan);
+	scan_drm_connectors(drm);
+}
+
 static int mhz_to_nsec(int mhz) {
 	return 1000000000000LL / mhz;
 }
 
 static void page_flip_handler(int fd, unsigned seq,
 		unsigned tv_sec, unsigned tv_usec, unsigned crtc_id, void *data) {
-	struct wlr_drm_backend *drm = data;
-
-	struct wlr_drm_connector *conn = NULL;
-	struct wlr_drm_connector *search;
-	wl_list_for_each(search, &drm->outputs, link) {
-		if (search->crtc && search->crtc->id == crtc_id) {
-			conn = search;
-			break;
-		}
-	}
+	// Page-flips are requested with their CRTC as user data
+	struct wlr_drm_crtc *crtc = data;
+	struct wlr_drm_connector *conn = crtc->conn;
 	if (!conn) {
 		wlr_log(WLR_DEBUG, "No connector for crtc_id %u", crtc_id);
 		return;
 	}
+	struct wlr_drm_backend *drm =
+		get_drm_backend_from_backend(conn->output.backend);
 
 	conn->pageflip_pending = false;
 
@@ -1506,14 +1905,21 @@ static void page_flip_handler(int fd, unsigned seq,
 		drm_fb_move(&conn->crtc->cursor->current_fb,
 			&conn->crtc->cursor->queued_fb);
 	}
+	// Page-flips always carry the overlays of the new frame, including the
+	// disabled ones
+	for (size_t i = 0; i < conn->crtc->num_overlays; ++i) {
+		struct wlr_drm_plane *overlay = conn->crtc->overlays[i];
+		drm_fb_move(&overlay->current_fb, &overlay->queued_fb);
+	}
 
 	uint32_t present_flags = WLR_OUTPUT_PRESENT_VSYNC |
 		WLR_OUTPUT_PRESENT_HW_CLOCK | WLR_OUTPUT_PRESENT_HW_COMPLETION;
-	/* Don't report ZERO_COPY in multi-gpu situations, because we had to copy
+	/* Don't report ZERO_COPY in multi-gpu situations where we had to copy
 	 * data between the GPUs, even if we were using the direct scanout
 	 * interface.
 	 */
-	if (!drm->parent && plane->current_fb.type == WLR_DRM_FB_TYPE_WLR_BUFFER) {
+	if (plane->current_fb.type == WLR_DRM_FB_TYPE_WLR_BUFFER &&
+			plane->current_fb.mgpu_surf == NULL) {
 		present_flags |= WLR_OUTPUT_PRESENT_ZERO_COPY;
 	}
 
@@ -1625,6 +2031,10 @@ static void drm_connector_cleanup(struct wlr_drm_connector *conn) {
 		conn->possible_crtc = 0;
 		conn->desired_mode = NULL;
 		conn->pageflip_pending = false;
+		if (conn->out_fence_fd >= 0) {
+			close(conn->out_fence_fd);
+			conn->out_fence_fd = -1;
+		}
 		wlr_signal_emit_safe(&conn->output.events.destroy, &conn->output);
 		break;
 	case WLR_DRM_CONN_DISCONNECTED:
@@ -113,7 +113,7 @@ static bool legacy_crtc_commit(struct wlr_drm_backend *drm,
 
 	if (flags & DRM_MODE_PAGE_FLIP_EVENT) {
 		if (drmModePageFlip(drm->fd, crtc->id, fb_id,
-				DRM_MODE_PAGE_FLIP_EVENT, drm)) {
+				DRM_MODE_PAGE_FLIP_EVENT, crtc)) {
 			wlr_log_errno(WLR_ERROR, "%s: Failed to page flip", conn->output.name);
 			return false;
 		}
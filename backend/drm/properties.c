@@ -2,6 +2,7 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/util/log.h>
 #include <xf86drm.h>
 #include <xf86drmMode.h>
@@ -34,6 +35,7 @@ static const struct prop_info crtc_info[] = {
 	{ "GAMMA_LUT", INDEX(gamma_lut) },
 	{ "GAMMA_LUT_SIZE", INDEX(gamma_lut_size) },
 	{ "MODE_ID", INDEX(mode_id) },
+	{ "OUT_FENCE_PTR", INDEX(out_fence_ptr) },
 	{ "VRR_ENABLED", INDEX(vrr_enabled) },
 	{ "rotation", INDEX(rotation) },
 	{ "scaling mode", INDEX(scaling_mode) },
@@ -48,6 +50,7 @@ static const struct prop_info plane_info[] = {
 	{ "CRTC_X", INDEX(crtc_x) },
 	{ "CRTC_Y", INDEX(crtc_y) },
 	{ "FB_ID", INDEX(fb_id) },
+	{ "IN_FENCE_FD", INDEX(in_fence_fd) },
 	{ "IN_FORMATS", INDEX(in_formats) },
 	{ "SRC_H", INDEX(src_h) },
 	{ "SRC_W", INDEX(src_w) },
@@ -64,7 +67,64 @@ static int cmp_prop_info(const void *arg1, const void *arg2) {
 	return strcmp(key, elem->name);
 }
 
-static bool scan_properties(int fd, uint32_t id, uint32_t type, uint32_t *result,
+struct wlr_drm_prop_name {
+	uint32_t id;
+	char name[DRM_PROP_NAME_LEN];
+};
+
+void finish_drm_prop_cache(struct wlr_drm_prop_cache *cache) {
+	free(cache->names);
+	memset(cache, 0, sizeof(*cache));
+}
+
+static bool get_prop_name(int fd, struct wlr_drm_prop_cache *cache,
+		uint32_t prop_id, char name[static DRM_PROP_NAME_LEN]) {
+	size_t lo = 0, hi = cache->len;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (cache->names[mid].id < prop_id) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	if (lo < cache->len && cache->names[lo].id == prop_id) {
+		memcpy(name, cache->names[lo].name, DRM_PROP_NAME_LEN);
+		return true;
+	}
+
+	drmModePropertyRes *prop = drmModeGetProperty(fd, prop_id);
+	if (!prop) {
+		wlr_log_errno(WLR_ERROR, "Failed to get DRM object property");
+		return false;
+	}
+	memcpy(name, prop->name, DRM_PROP_NAME_LEN);
+	name[DRM_PROP_NAME_LEN - 1] = '\0';
+	drmModeFreeProperty(prop);
+
+	if (cache->len == cache->cap) {
+		size_t cap = cache->cap ? cache->cap * 2 : 64;
+		struct wlr_drm_prop_name *names =
+			realloc(cache->names, cap * sizeof(*names));
+		if (!names) {
+			// Not fatal, the property will be queried again next time
+			wlr_log_errno(WLR_ERROR, "Allocation failed");
+			return true;
+		}
+		cache->names = names;
+		cache->cap = cap;
+	}
+
+	memmove(&cache->names[lo + 1], &cache->names[lo],
+		(cache->len - lo) * sizeof(cache->names[0]));
+	cache->names[lo].id = prop_id;
+	memcpy(cache->names[lo].name, name, DRM_PROP_NAME_LEN);
+	cache->len++;
+	return true;
+}
+
+static bool scan_properties(int fd, struct wlr_drm_prop_cache *cache,
+		uint32_t id, uint32_t type, uint32_t *result,
 		const struct prop_info *info, size_t info_len) {
 	drmModeObjectProperties *props = drmModeObjectGetProperties(fd, id, type);
 	if (!props) {
@@ -73,38 +133,38 @@ static bool scan_properties(int fd, uint32_t id, uint32_t type, uint32_t *result
 	}
 
 	for (uint32_t i = 0; i < props->count_props; ++i) {
-		drmModePropertyRes *prop = drmModeGetProperty(fd, props->props[i]);
-		if (!prop) {
-			wlr_log_errno(WLR_ERROR, "Failed to get DRM object property");
+		char name[DRM_PROP_NAME_LEN];
+		if (!get_prop_name(fd, cache, props->props[i], name)) {
 			continue;
 		}
 
 		const struct prop_info *p =
-			bsearch(prop->name, info, info_len, sizeof(info[0]), cmp_prop_info);
+			bsearch(name, info, info_len, sizeof(info[0]), cmp_prop_info);
 		if (p) {
-			result[p->index] = prop->prop_id;
+			result[p->index] = props->props[i];
 		}
-
-		drmModeFreeProperty(prop);
 	}
 
 	drmModeFreeObjectProperties(props);
 	return true;
 }
 
-bool get_drm_connector_props(int fd, uint32_t id,
-		union wlr_drm_connector_props *out) {
-	return scan_properties(fd, id, DRM_MODE_OBJECT_CONNECTOR, out->props,
-		connector_info, sizeof(connector_info) / sizeof(connector_info[0]));
+bool get_drm_connector_props(int fd, struct wlr_drm_prop_cache *cache,
+		uint32_t id, union wlr_drm_connector_props *out) {
+	return scan_properties(fd, cache, id, DRM_MODE_OBJECT_CONNECTOR,
+		out->props, connector_info,
+		sizeof(connector_info) / sizeof(connector_info[0]));
 }
 
-bool get_drm_crtc_props(int fd, uint32_t id, union wlr_drm_crtc_props *out) {
-	return scan_properties(fd, id, DRM_MODE_OBJECT_CRTC, out->props,
+bool get_drm_crtc_props(int fd, struct wlr_drm_prop_cache *cache,
+		uint32_t id, union wlr_drm_crtc_props *out) {
+	return scan_properties(fd, cache, id, DRM_MODE_OBJECT_CRTC, out->props,
 		crtc_info, sizeof(crtc_info) / sizeof(crtc_info[0]));
 }
 
-bool get_drm_plane_props(int fd, uint32_t id, union wlr_drm_plane_props *out) {
-	return scan_properties(fd, id, DRM_MODE_OBJECT_PLANE, out->props,
+bool get_drm_plane_props(int fd, struct wlr_drm_prop_cache *cache,
+		uint32_t id, union wlr_drm_plane_props *out) {
+	return scan_properties(fd, cache, id, DRM_MODE_OBJECT_PLANE, out->props,
 		plane_info, sizeof(plane_info) / sizeof(plane_info[0]));
 }
 
@@ -12,6 +12,7 @@
 #include <wlr/types/wlr_matrix.h>
 #include <wlr/util/log.h>
 #include "backend/drm/drm.h"
+#include "backend/drm/util.h"
 
 bool init_drm_renderer(struct wlr_drm_backend *drm,
 		struct wlr_drm_renderer *renderer, wlr_renderer_create_func_t create_renderer_func) {
@@ -79,7 +80,7 @@ static bool init_drm_surface(struct wlr_drm_surface *surf,
 	}
 	wlr_egl_destroy_surface(&surf->renderer->egl, surf->egl);
 
-	if (!(flags & GBM_BO_USE_LINEAR) && set != NULL) {
+	if (set != NULL) {
 		const struct wlr_drm_format *drm_format =
 			wlr_drm_format_set_get(set, format);
 		if (drm_format != NULL) {
@@ -207,6 +208,35 @@ static uint32_t strip_alpha_channel(uint32_t format) {
 	}
 }
 
+/*
+ * Collects the explicit modifiers of the format that the secondary GPU can
+ * scan out, and that both GPUs can import. The latter makes sure that copying
+ * is still possible if scanning out a buffer turns out to fail.
+ */
+static void get_mgpu_format_set(struct wlr_drm_format_set *shared,
+		struct wlr_drm_backend *drm, const struct wlr_drm_format_set *set,
+		uint32_t format) {
+	const struct wlr_drm_format *fmt = wlr_drm_format_set_get(set, format);
+	if (fmt == NULL) {
+		return;
+	}
+
+	const struct wlr_drm_format_set *parent_set =
+		wlr_egl_get_dmabuf_formats(&drm->parent->renderer.egl);
+	const struct wlr_drm_format_set *mgpu_set =
+		wlr_egl_get_dmabuf_formats(&drm->renderer.egl);
+	for (size_t i = 0; i < fmt->len; ++i) {
+		uint64_t mod = fmt->modifiers[i];
+		if (mod == DRM_FORMAT_MOD_INVALID) {
+			continue;
+		}
+		if (wlr_drm_format_set_has(parent_set, format, mod) &&
+				wlr_drm_format_set_has(mgpu_set, format, mod)) {
+			wlr_drm_format_set_add(shared, format, mod);
+		}
+	}
+}
+
 bool drm_plane_init_surface(struct wlr_drm_plane *plane,
 		struct wlr_drm_backend *drm, int32_t width, uint32_t height,
 		uint32_t format, uint32_t flags, bool with_modifiers) {
@@ -229,9 +259,18 @@ bool drm_plane_init_surface(struct wlr_drm_plane *plane,
 			format, format_set, flags | GBM_BO_USE_SCANOUT);
 	}
 
-	if (!init_drm_surface(&plane->surf, &drm->parent->renderer,
-			width, height, format, NULL,
-			flags | GBM_BO_USE_LINEAR)) {
+	// Allocate with a modifier both GPUs agree on when possible, so that the
+	// buffers can be scanned out without any copy. Linear is the fallback.
+	struct wlr_drm_format_set shared_set = {0};
+	if (format_set != NULL) {
+		get_mgpu_format_set(&shared_set, drm, format_set, format);
+	}
+
+	bool ok = init_drm_surface(&plane->surf, &drm->parent->renderer,
+		width, height, format, shared_set.len > 0 ? &shared_set : NULL,
+		flags | GBM_BO_USE_LINEAR);
+	wlr_drm_format_set_finish(&shared_set);
+	if (!ok) {
 		return false;
 	}
 
@@ -252,6 +291,9 @@ void drm_fb_clear(struct wlr_drm_fb *fb) {
 		break;
 	case WLR_DRM_FB_TYPE_SURFACE:
 		gbm_surface_release_buffer(fb->surf->gbm, fb->bo);
+		if (fb->in_fence_fd >= 0) {
+			close(fb->in_fence_fd);
+		}
 		break;
 	case WLR_DRM_FB_TYPE_WLR_BUFFER:
 		gbm_bo_destroy(fb->bo);
@@ -264,32 +306,91 @@ void drm_fb_clear(struct wlr_drm_fb *fb) {
 	fb->bo = NULL;
 
 	if (fb->mgpu_bo) {
-		assert(fb->mgpu_surf);
-		gbm_surface_release_buffer(fb->mgpu_surf->gbm, fb->mgpu_bo);
+		if (fb->mgpu_surf) {
+			gbm_surface_release_buffer(fb->mgpu_surf->gbm, fb->mgpu_bo);
+		} else {
+			gbm_bo_destroy(fb->mgpu_bo);
+		}
 		fb->mgpu_bo = NULL;
 		fb->mgpu_surf = NULL;
 	}
 }
 
 bool drm_fb_lock_surface(struct wlr_drm_fb *fb, struct wlr_drm_surface *surf) {
+	struct wlr_egl *egl = &surf->renderer->egl;
+
 	drm_fb_clear(fb);
 
-	if (!wlr_egl_swap_buffers(&surf->renderer->egl, surf->egl, NULL)) {
+	// Let the atomic commit wait for the rendering with an explicit fence,
+	// instead of relying on implicit synchronization
+	EGLSyncKHR sync = wlr_egl_create_fence(egl);
+
+	if (!wlr_egl_swap_buffers(egl, surf->egl, NULL)) {
 		wlr_log(WLR_ERROR, "Failed to swap buffers");
+		wlr_egl_destroy_sync(egl, sync);
 		return false;
 	}
 
+	// Swapping buffers flushed the commands, the fence can be exported
+	int in_fence_fd = -1;
+	if (sync != EGL_NO_SYNC_KHR) {
+		in_fence_fd = wlr_egl_dup_fence_fd(egl, sync);
+		wlr_egl_destroy_sync(egl, sync);
+	}
+
 	fb->bo = gbm_surface_lock_front_buffer(surf->gbm);
 	if (!fb->bo) {
 		wlr_log(WLR_ERROR, "Failed to lock front buffer");
+		if (in_fence_fd >= 0) {
+			close(in_fence_fd);
+		}
 		return false;
 	}
 
 	fb->type = WLR_DRM_FB_TYPE_SURFACE;
 	fb->surf = surf;
+	fb->in_fence_fd = in_fence_fd;
 	return true;
 }
 
+static struct gbm_bo *import_dmabuf(struct wlr_drm_renderer *renderer,
+		const struct wlr_dmabuf_attributes *attribs) {
+	if (attribs->modifier != DRM_FORMAT_MOD_INVALID ||
+			attribs->n_planes > 1 || attribs->offset[0] != 0) {
+		struct gbm_import_fd_modifier_data data = {
+			.width = attribs->width,
+			.height = attribs->height,
+			.format = attribs->format,
+			.num_fds = attribs->n_planes,
+			.modifier = attribs->modifier,
+		};
+
+		if ((size_t)attribs->n_planes > sizeof(data.fds) / sizeof(data.fds[0])) {
+			return NULL;
+		}
+
+		for (size_t i = 0; i < (size_t)attribs->n_planes; ++i) {
+			data.fds[i] = attribs->fd[i];
+			data.strides[i] = attribs->stride[i];
+			data.offsets[i] = attribs->offset[i];
+		}
+
+		return gbm_bo_import(renderer->gbm, GBM_BO_IMPORT_FD_MODIFIER,
+			&data, GBM_BO_USE_SCANOUT);
+	} else {
+		struct gbm_import_fd_data data = {
+			.fd = attribs->fd[0],
+			.width = attribs->width,
+			.height = attribs->height,
+			.stride = attribs->stride[0],
+			.format = attribs->format,
+		};
+
+		return gbm_bo_import(renderer->gbm, GBM_BO_IMPORT_FD,
+			&data, GBM_BO_USE_SCANOUT);
+	}
+}
+
 bool drm_fb_import_wlr(struct wlr_drm_fb *fb, struct wlr_drm_renderer *renderer,
 		struct wlr_buffer *buf, struct wlr_drm_format_set *set) {
 	drm_fb_clear(fb);
@@ -310,41 +411,7 @@ bool drm_fb_import_wlr(struct wlr_drm_fb *fb, struct wlr_drm_renderer *renderer,
 		}
 	}
 
-	if (attribs.modifier != DRM_FORMAT_MOD_INVALID ||
-			attribs.n_planes > 1 || attribs.offset[0] != 0) {
-		struct gbm_import_fd_modifier_data data = {
-			.width = attribs.width,
-			.height = attribs.height,
-			.format = attribs.format,
-			.num_fds = attribs.n_planes,
-			.modifier = attribs.modifier,
-		};
-
-		if ((size_t)attribs.n_planes > sizeof(data.fds) / sizeof(data.fds[0])) {
-			return false;
-		}
-
-		for (size_t i = 0; i < (size_t)attribs.n_planes; ++i) {
-			data.fds[i] = attribs.fd[i];
-			data.strides[i] = attribs.stride[i];
-			data.offsets[i] = attribs.offset[i];
-		}
-
-		fb->bo = gbm_bo_import(renderer->gbm, GBM_BO_IMPORT_FD_MODIFIER,
-			&data, GBM_BO_USE_SCANOUT);
-	} else {
-		struct gbm_import_fd_data data = {
-			.fd = attribs.fd[0],
-			.width = attribs.width,
-			.height = attribs.height,
-			.stride = attribs.stride[0],
-			.format = attribs.format,
-		};
-
-		fb->bo = gbm_bo_import(renderer->gbm, GBM_BO_IMPORT_FD,
-			&data, GBM_BO_USE_SCANOUT);
-	}
-
+	fb->bo = import_dmabuf(renderer, &attribs);
 	if (!fb->bo) {
 		return false;
 	}
@@ -375,6 +442,27 @@ bool drm_surface_render_black_frame(struct wlr_drm_surface *surf) {
 	return true;
 }
 
+static struct gbm_bo *import_mgpu_bo(struct wlr_drm_backend *drm,
+		struct gbm_bo *bo) {
+	struct wlr_dmabuf_attributes attribs;
+	if (!export_drm_bo(bo, &attribs)) {
+		return NULL;
+	}
+
+	struct gbm_bo *mgpu_bo = import_dmabuf(&drm->renderer, &attribs);
+	wlr_dmabuf_attributes_finish(&attribs);
+	if (!mgpu_bo) {
+		return NULL;
+	}
+
+	if (!get_fb_for_bo(mgpu_bo, drm->addfb2_modifiers)) {
+		gbm_bo_destroy(mgpu_bo);
+		return NULL;
+	}
+
+	return mgpu_bo;
+}
+
 struct gbm_bo *drm_fb_acquire(struct wlr_drm_fb *fb, struct wlr_drm_backend *drm,
 		struct wlr_drm_surface *mgpu) {
 	if (!fb->bo) {
@@ -390,6 +478,20 @@ struct gbm_bo *drm_fb_acquire(struct wlr_drm_fb *fb, struct wlr_drm_backend *drm
 		return fb->mgpu_bo;
 	}
 
+	if (fb->type == WLR_DRM_FB_TYPE_WLR_BUFFER || !mgpu->needs_copy) {
+		fb->mgpu_bo = import_mgpu_bo(drm, fb->bo);
+		if (fb->mgpu_bo) {
+			return fb->mgpu_bo;
+		}
+
+		// Rendered buffers all share the same layout, don't try again
+		if (fb->type == WLR_DRM_FB_TYPE_SURFACE) {
+			wlr_log(WLR_DEBUG, "Failed to scan out buffer from parent GPU "
+				"directly, falling back to copies");
+			mgpu->needs_copy = true;
+		}
+	}
+
 	/* Perform copy across GPUs */
 
 	struct wlr_texture *tex = get_tex_for_bo(mgpu->renderer, fb->bo);
@@ -1,12 +1,12 @@
 #include <assert.h>
-#include <GLES2/gl2.h>
-#include <GLES2/gl2ext.h>
 #include <stdlib.h>
 #include <wlr/interfaces/wlr_input_device.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/egl.h>
 #include <wlr/util/log.h>
 #include "backend/headless.h"
+#include "render/allocator.h"
+#include "render/gles2.h"
 #include "util/signal.h"
 
 struct wlr_headless_backend *headless_backend_from_backend(
@@ -62,6 +62,8 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 
 	wlr_signal_emit_safe(&wlr_backend->events.destroy, backend);
 
+	wlr_allocator_destroy(backend->allocator);
+
 	if (backend->egl == &backend->priv_egl) {
 		wlr_renderer_destroy(backend->renderer);
 		wlr_egl_finish(&backend->priv_egl);
@@ -104,16 +106,10 @@ static bool backend_init(struct wlr_headless_backend *backend,
 	backend->renderer = renderer;
 	backend->egl = wlr_gles2_renderer_get_egl(renderer);
 
-	if (wlr_gles2_renderer_check_ext(backend->renderer, "GL_OES_rgb8_rgba8") ||
-			wlr_gles2_renderer_check_ext(backend->renderer,
-				"GL_OES_required_internalformat") ||
-			wlr_gles2_renderer_check_ext(backend->renderer, "GL_ARM_rgba8")) {
-		backend->internal_format = GL_RGBA8_OES;
-	} else {
-		wlr_log(WLR_INFO, "GL_RGBA8_OES not supported, "
-			"falling back to GL_RGBA4 internal format "
-			"(performance may be affected)");
-		backend->internal_format = GL_RGBA4;
+	backend->allocator = gles2_allocator_create(renderer);
+	if (backend->allocator == NULL) {
+		wlr_log(WLR_ERROR, "Failed to create allocator");
+		return false;
 	}
 
 	backend->display_destroy.notify = handle_display_destroy;
@@ -1,4 +1,5 @@
 #include <assert.h>
+#include <drm_fourcc.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <stdlib.h>
@@ -6,6 +7,8 @@
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/util/log.h>
 #include "backend/headless.h"
+#include "render/gles2.h"
+#include "render/swapchain.h"
 #include "util/signal.h"
 
 static struct wlr_headless_output *headless_output_from_output(
@@ -14,51 +17,15 @@ static struct wlr_headless_output *headless_output_from_output(
 	return (struct wlr_headless_output *)wlr_output;
 }
 
-static bool create_fbo(struct wlr_headless_output *output,
-		unsigned int width, unsigned int height) {
-	if (!wlr_egl_make_current(output->backend->egl, EGL_NO_SURFACE, NULL)) {
-		return false;
-	}
-
-	GLuint rbo;
-	glGenRenderbuffers(1, &rbo);
-	glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-	glRenderbufferStorage(GL_RENDERBUFFER, output->backend->internal_format,
-		width, height);
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-	GLuint fbo;
-	glGenFramebuffers(1, &fbo);
-	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-		GL_RENDERBUFFER, rbo);
-	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	wlr_egl_unset_current(output->backend->egl);
-
-	if (status != GL_FRAMEBUFFER_COMPLETE) {
-		wlr_log(WLR_ERROR, "Failed to create FBO");
-		return false;
-	}
-
-	output->fbo = fbo;
-	output->rbo = rbo;
-	return true;
-}
-
-static void destroy_fbo(struct wlr_headless_output *output) {
-	if (!wlr_egl_make_current(output->backend->egl, EGL_NO_SURFACE, NULL)) {
-		return;
-	}
-
-	glDeleteFramebuffers(1, &output->fbo);
-	glDeleteRenderbuffers(1, &output->rbo);
-
-	wlr_egl_unset_current(output->backend->egl);
+static const struct wlr_drm_format headless_format = {
+	.format = DRM_FORMAT_XRGB8888,
+};
 
-	output->fbo = 0;
-	output->rbo = 0;
+static void output_release_buffers(struct wlr_headless_output *output) {
+	wlr_buffer_unlock(output->back_buffer);
+	output->back_buffer = NULL;
+	wlr_buffer_unlock(output->front_buffer);
+	output->front_buffer = NULL;
 }
 
 static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
@@ -70,10 +37,19 @@ static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 		refresh = HEADLESS_DEFAULT_REFRESH;
 	}
 
-	destroy_fbo(output);
-	if (!create_fbo(output, width, height)) {
-		wlr_output_destroy(wlr_output);
-		return false;
+	// The buffers are kept around as long as the size doesn't change
+	struct wlr_swapchain *swapchain = output->swapchain;
+	if (swapchain == NULL || swapchain->width != width ||
+			swapchain->height != height) {
+		swapchain = wlr_swapchain_create(output->backend->allocator,
+			width, height, &headless_format);
+		if (swapchain == NULL) {
+			wlr_log(WLR_ERROR, "Failed to create swapchain");
+			return false;
+		}
+		output_release_buffers(output);
+		wlr_swapchain_destroy(output->swapchain);
+		output->swapchain = swapchain;
 	}
 
 	output->frame_delay = 1000000 / refresh;
@@ -87,15 +63,19 @@ static bool output_attach_render(struct wlr_output *wlr_output,
 	struct wlr_headless_output *output =
 		headless_output_from_output(wlr_output);
 
-	if (!wlr_egl_make_current(output->backend->egl, EGL_NO_SURFACE, NULL)) {
+	wlr_buffer_unlock(output->back_buffer);
+	output->back_buffer = wlr_swapchain_acquire(output->swapchain, buffer_age);
+	if (output->back_buffer == NULL) {
 		return false;
 	}
 
-	glBindFramebuffer(GL_FRAMEBUFFER, output->fbo);
-
-	if (buffer_age != NULL) {
-		*buffer_age = 0; // We only have one buffer
+	if (!wlr_egl_make_current(output->backend->egl, EGL_NO_SURFACE, NULL)) {
+		wlr_buffer_unlock(output->back_buffer);
+		output->back_buffer = NULL;
+		return false;
 	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, gles2_buffer_get_fbo(output->back_buffer));
 	return true;
 }
 
@@ -133,7 +113,19 @@ static bool output_commit(struct wlr_output *wlr_output) {
 		glBindFramebuffer(GL_FRAMEBUFFER, 0);
 		wlr_egl_unset_current(output->backend->egl);
 
-		// Nothing needs to be done for FBOs
+		// The back buffer is gone if the mode change above resized the
+		// swapchain
+		if (output->back_buffer != NULL) {
+			wlr_swapchain_set_buffer_submitted(output->swapchain,
+				output->back_buffer);
+
+			// Keep the last frame locked, so that the next buffer acquired
+			// from the swapchain is a different one
+			wlr_buffer_unlock(output->front_buffer);
+			output->front_buffer = output->back_buffer;
+			output->back_buffer = NULL;
+		}
+
 		wlr_output_send_present(wlr_output, NULL);
 	}
 
@@ -146,14 +138,19 @@ static void output_rollback_render(struct wlr_output *wlr_output) {
 	assert(wlr_egl_is_current(output->backend->egl));
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 	wlr_egl_unset_current(output->backend->egl);
+	wlr_buffer_unlock(output->back_buffer);
+	output->back_buffer = NULL;
 }
 
 static void output_destroy(struct wlr_output *wlr_output) {
 	struct wlr_headless_output *output =
 		headless_output_from_output(wlr_output);
 	wl_list_remove(&output->link);
-	wl_event_source_remove(output->frame_timer);
-	destroy_fbo(output);
+	if (output->frame_timer != NULL) {
+		wl_event_source_remove(output->frame_timer);
+	}
+	output_release_buffers(output);
+	wlr_swapchain_destroy(output->swapchain);
 	free(output);
 }
 
@@ -187,15 +184,14 @@ struct wlr_output *wlr_headless_add_output(struct wlr_backend *wlr_backend,
 		return NULL;
 	}
 	output->backend = backend;
+	wl_list_init(&output->link);
 	wlr_output_init(&output->wlr_output, &backend->backend, &output_impl,
 		backend->display);
 	struct wlr_output *wlr_output = &output->wlr_output;
 
-	if (!create_fbo(output, width, height)) {
+	if (!output_set_custom_mode(wlr_output, width, height, 0)) {
 		goto error;
 	}
-
-	output_set_custom_mode(wlr_output, width, height, 0);
 	strncpy(wlr_output->make, "headless", sizeof(wlr_output->make));
 	strncpy(wlr_output->model, "headless", sizeof(wlr_output->model));
 	snprintf(wlr_output->name, sizeof(wlr_output->name), "HEADLESS-%zd",
@@ -5,6 +5,7 @@
 #include "util/signal.h"
 #include <stdlib.h>
 #include <wayland-util.h>
+#include <wlr/config.h>
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/egl.h>
 #include <wlr/render/gles2.h>
@@ -69,6 +70,7 @@ static void backend_destroy(struct wlr_backend *wlr_backend) {
 
 	wlr_signal_emit_safe(&wlr_backend->events.destroy, hwc_backend);
 
+	hwcomposer_finish_import_buffer(hwc_backend);
 	wlr_renderer_destroy(hwc_backend->renderer);
 	wlr_egl_finish(&hwc_backend->egl);
 	free(hwc_backend);
@@ -129,9 +131,22 @@ void hwcomposer_init(struct wlr_hwcomposer_backend *hwc_backend) {
 		int idle_time = (int)strtol(idle_time_env, &end, 10);
 
 		hwc_backend->idle_time = (*end || idle_time < 2) ? 2 * 1000000 : idle_time * 1000000;
+		hwc_backend->idle_time_fixed = true;
 	} else {
-		// Default to 2
+		// Default to 2, then measured per output
 		hwc_backend->idle_time = 2 * 1000000;
+		hwc_backend->idle_time_fixed = false;
+	}
+
+	char *render_margin_env = getenv("WLR_HWC_RENDER_MARGIN");
+	if (render_margin_env) {
+		char *end;
+		int render_margin = (int)strtol(render_margin_env, &end, 10);
+
+		hwc_backend->render_margin = (*end || render_margin < 0) ? 1000000 : render_margin * 1000000;
+	} else {
+		// Default to 1
+		hwc_backend->render_margin = 1000000;
 	}
 }
 
@@ -150,8 +165,14 @@ struct wlr_backend *wlr_hwcomposer_backend_create(struct wl_display *display,
 	int hwc_version = HWC_DEVICE_API_VERSION_1_3;
 #endif // HWC_DEVICE_API_VERSION_2_0
 
+#if WLR_HAS_HWCOMPOSER_MOCK
+	// The mock doesn't need the real hwcomposer to be opened
+	bool skip_version_check = true;
+#else
 	// Allow skipping version check via WLR_HWC_SKIP_VERSION_CHECK env variable
-	if (getenv("WLR_HWC_SKIP_VERSION_CHECK") == NULL) {
+	bool skip_version_check = getenv("WLR_HWC_SKIP_VERSION_CHECK") != NULL;
+#endif
+	if (!skip_version_check) {
 		err = hw_get_module(HWC_HARDWARE_MODULE_ID, (const hw_module_t **) &hwc_module);
 
 		if (err == 0) {
@@ -223,11 +244,7 @@ struct wlr_backend *wlr_hwcomposer_backend_create(struct wl_display *display,
 
 	hwc_backend->egl.display = eglGetDisplay(NULL);
 
-	// Prepare global vsync variables
-	struct timespec now;
-	clock_gettime(CLOCK_MONOTONIC, &now);
-	hwc_backend->hwc_vsync_last_timestamp = now.tv_sec * 1000000000 + now.tv_nsec;
-	hwc_backend->hwc_vsync_enabled = false;
+	hwcomposer_init_import_buffer(hwc_backend);
 
 	// Register hwc callbacks
 	hwc_backend->impl->register_callbacks(hwc_backend);
@@ -255,6 +272,15 @@ void wlr_hwcomposer_backend_handle_hotplug(struct wlr_backend *wlr_backend,
 	}
 }
 
+void wlr_hwcomposer_backend_set_import_buffer(struct wlr_backend *wlr_backend,
+		wlr_hwcomposer_import_buffer_func_t import_buffer, void *data) {
+	assert(wlr_backend_is_hwcomposer(wlr_backend));
+	struct wlr_hwcomposer_backend *hwc_backend =
+		(struct wlr_hwcomposer_backend *)wlr_backend;
+	hwc_backend->import_buffer = import_buffer;
+	hwc_backend->import_buffer_data = data;
+}
+
 bool wlr_backend_is_hwcomposer(struct wlr_backend *backend) {
 	return backend->impl == &backend_impl;
 }
@@ -0,0 +1,142 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <EGL/egl.h>
+#include <errno.h>
+#include <linux/dma-buf.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/util/log.h>
+#include "backend/hwcomposer.h"
+
+// Linux 6.0 uapi, missing from older kernel headers
+#ifndef DMA_BUF_IOCTL_EXPORT_SYNC_FILE
+struct dma_buf_export_sync_file {
+	__u32 flags;
+	__s32 fd;
+};
+#define DMA_BUF_IOCTL_EXPORT_SYNC_FILE \
+	_IOWR(DMA_BUF_BASE, 2, struct dma_buf_export_sync_file)
+#endif
+
+int hwcomposer_buffer_get_acquire_fence(struct wlr_buffer *buffer) {
+	// Buffers without a DMA-BUF, such as android_wlegl ones, are only
+	// attached by libhybris clients once their rendering has completed
+	struct wlr_dmabuf_attributes attribs;
+	if (!wlr_buffer_get_dmabuf(buffer, &attribs)) {
+		return -1;
+	}
+
+	// Fences of the pending writes, which readers have to wait for
+	struct dma_buf_export_sync_file req = {
+		.flags = DMA_BUF_SYNC_READ,
+		.fd = -1,
+	};
+	int ret;
+	do {
+		ret = ioctl(attribs.fd[0], DMA_BUF_IOCTL_EXPORT_SYNC_FILE, &req);
+	} while (ret == -1 && errno == EINTR);
+	if (ret != 0) {
+		return -1;
+	}
+	return req.fd;
+}
+
+static void native_buffer_destroy(struct wlr_hwcomposer_native_buffer *native) {
+	struct wlr_hwcomposer_backend *hwc_backend = native->hwc_backend;
+	hwc_backend->egl_release_native_buffer(hwc_backend->egl.display,
+		native->native);
+	wl_list_remove(&native->buffer_destroy.link);
+	wl_list_remove(&native->link);
+	free(native);
+}
+
+static void native_buffer_handle_buffer_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_hwcomposer_native_buffer *native =
+		wl_container_of(listener, native, buffer_destroy);
+	native_buffer_destroy(native);
+}
+
+static struct ANativeWindowBuffer *import_buffer(struct wlr_buffer *buffer,
+		void *data) {
+	struct wlr_hwcomposer_backend *hwc_backend = data;
+
+	struct wlr_client_buffer *client_buffer = wlr_client_buffer_get(buffer);
+	if (client_buffer == NULL || client_buffer->resource == NULL) {
+		return NULL;
+	}
+
+	struct wlr_hwcomposer_native_buffer *native;
+	wl_list_for_each(native, &hwc_backend->native_buffers, link) {
+		if (native->buffer == buffer) {
+			if (native->resource == client_buffer->resource) {
+				return native->native;
+			}
+			// The client buffer has been updated with another wl_buffer
+			native_buffer_destroy(native);
+			break;
+		}
+	}
+
+	// Fails for wl_buffers which aren't android_wlegl ones, such as shm
+	// buffers
+	EGLClientBuffer egl_buffer = NULL;
+	if (!hwc_backend->egl_acquire_native_buffer(hwc_backend->egl.display,
+			client_buffer->resource, &egl_buffer)) {
+		return NULL;
+	}
+
+	native = calloc(1, sizeof(struct wlr_hwcomposer_native_buffer));
+	if (native == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		hwc_backend->egl_release_native_buffer(hwc_backend->egl.display,
+			egl_buffer);
+		return NULL;
+	}
+	native->hwc_backend = hwc_backend;
+	native->buffer = buffer;
+	native->resource = client_buffer->resource;
+	native->native = egl_buffer;
+	native->buffer_destroy.notify = native_buffer_handle_buffer_destroy;
+	wl_signal_add(&buffer->events.destroy, &native->buffer_destroy);
+	wl_list_insert(&hwc_backend->native_buffers, &native->link);
+
+	return native->native;
+}
+
+void hwcomposer_init_import_buffer(struct wlr_hwcomposer_backend *hwc_backend) {
+	wl_list_init(&hwc_backend->native_buffers);
+
+	const char *exts = eglQueryString(hwc_backend->egl.display, EGL_EXTENSIONS);
+	if (exts == NULL ||
+			strstr(exts, "EGL_HYBRIS_WL_acquire_native_buffer") == NULL) {
+		wlr_log(WLR_INFO, "EGL_HYBRIS_WL_acquire_native_buffer not supported, "
+			"direct scan-out needs a custom buffer importer");
+		return;
+	}
+
+	hwc_backend->egl_acquire_native_buffer = (PFNEGLHYBRISACQUIRENATIVEBUFFERWL)
+		eglGetProcAddress("eglHybrisAcquireNativeBufferWL");
+	hwc_backend->egl_release_native_buffer = (PFNEGLHYBRISRELEASENATIVEBUFFERWL)
+		eglGetProcAddress("eglHybrisReleaseNativeBufferWL");
+	if (hwc_backend->egl_acquire_native_buffer == NULL ||
+			hwc_backend->egl_release_native_buffer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to load EGL_HYBRIS_WL_acquire_native_buffer "
+			"functions");
+		return;
+	}
+
+	hwc_backend->import_buffer = import_buffer;
+	hwc_backend->import_buffer_data = hwc_backend;
+}
+
+void hwcomposer_finish_import_buffer(struct wlr_hwcomposer_backend *hwc_backend) {
+	struct wlr_hwcomposer_native_buffer *native, *tmp;
+	wl_list_for_each_safe(native, tmp, &hwc_backend->native_buffers, link) {
+		native_buffer_destroy(native);
+	}
+}
@@ -0,0 +1,739 @@
+/*
+ * In-process replacement for libhybris' HWC2 compatibility layer, used when
+ * building with -Dhwcomposer-mock=true. It doesn't drive any display: it
+ * emits synthetic VSYNC and hotplug events, returns present fences signaled
+ * at the next synthetic VSYNC and records the timing of every present, so
+ * that the frame scheduling of the hwcomposer backend can be measured without
+ * interference from a real composer, e.g. with the frame-pacing example.
+ *
+ * The optional functions of the compatibility layer are provided when the
+ * libhybris headers declare them: multiple display configs with the 2.4 VSYNC
+ * callback, layer z-order and surface damage. Validate demotes the device
+ * layers in excess of WLR_HWC_MOCK_DEVICE_LAYERS to client composition.
+ *
+ * Only the composer is replaced: buffers are still allocated and rendered
+ * through libhybris' native window and EGL, so the mock runs on an Android
+ * device, not on a plain Linux host.
+ *
+ * The mock is configured with environment variables, see docs/env_vars.md.
+ */
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <android-config.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <hardware/hwcomposer.h>
+#include <hybris/hwc2/hwc2_compatibility_layer.h>
+
+#include <wlr/config.h>
+#include <wlr/util/log.h>
+
+#define MOCK_DEFAULT_WIDTH 1080
+#define MOCK_DEFAULT_HEIGHT 2340
+#define MOCK_DEFAULT_REFRESH 60 // Hz
+#define MOCK_DEFAULT_REPORT 600 // frames
+#define MOCK_MAX_CONFIGS 8
+// Present intervals are counted in VSYNC periods up to this bucket
+#define MOCK_INTERVAL_BUCKETS 5
+// Latencies are counted in eighths of the VSYNC period
+#define MOCK_LATENCY_BUCKETS 8
+
+// ABI of the kernel's sw_sync debug driver, which isn't part of the uapi
+// headers. Its timeline is advanced on every VSYNC to signal present fences.
+struct mock_sw_sync_create_fence_data {
+	uint32_t value;
+	char name[32];
+	int32_t fence;
+};
+#define MOCK_SW_SYNC_IOC_CREATE_FENCE \
+	_IOWR('W', 0, struct mock_sw_sync_create_fence_data)
+#define MOCK_SW_SYNC_IOC_INC _IOW('W', 1, uint32_t)
+
+typedef void (*mock_vsync_2_4_func_t)(HWC2EventListener *listener,
+	int32_t sequence_id, hwc2_display_t display, int64_t timestamp,
+	int64_t vsync_period_nanos);
+
+struct mock_stats {
+	size_t frames;
+	size_t skipped_vsyncs;
+	// Layers demoted to client composition by validate
+	size_t demoted_layers;
+	// Damage rectangles reported on layers, none meaning fully damaged
+	size_t damage_rects;
+	size_t intervals[MOCK_INTERVAL_BUCKETS];
+	size_t latencies[MOCK_LATENCY_BUCKETS];
+	int64_t latency_min, latency_max, latency_sum; // nsec
+	int64_t last_present; // nsec
+};
+
+struct hwc2_compat_display
+{
+	struct hwc2_compat_device *device;
+	hwc2_display_t id;
+
+	HWC2DisplayConfig configs[MOCK_MAX_CONFIGS];
+	size_t configs_len;
+	size_t active_config;
+
+	atomic_bool vsync_enabled;
+	bool powered;
+	bool validated;
+	struct hwc2_compat_layer *layers;
+	// Layers the device can present, the others are demoted to client
+	// composition by validate
+	size_t max_device_layers;
+
+	struct mock_stats stats;
+};
+
+struct hwc2_compat_layer
+{
+	struct hwc2_compat_display *display;
+	struct hwc2_compat_layer *next; // hwc2_compat_display::layers
+	int composition_type;
+	uint32_t z_order;
+	// Set by validate, applied by accept_changes
+	bool demote;
+};
+
+struct hwc2_compat_out_fences
+{
+	int unused;
+};
+
+struct hwc2_compat_device
+{
+	HWC2EventListener *listener;
+	int32_t sequence_id;
+	mock_vsync_2_4_func_t vsync_2_4;
+	int32_t vsync_2_4_sequence_id;
+
+	struct hwc2_compat_display primary;
+
+	pthread_t vsync_thread;
+	bool vsync_thread_started;
+	atomic_int_fast64_t vsync_period; // nsec
+	atomic_int_fast64_t vsync_last; // nsec
+	// sw_sync timeline advanced on every VSYNC, -1 if unavailable
+	int timeline_fd;
+	atomic_uint_fast32_t vsync_count;
+	int64_t jitter; // nsec
+	size_t report_interval;
+};
+
+static int64_t mock_get_time(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+static int64_t mock_env_int(const char *name, int64_t def, int64_t min)
+{
+	const char *env = getenv(name);
+	if (env == NULL) {
+		return def;
+	}
+
+	char *end;
+	long long value = strtoll(env, &end, 10);
+	if (*end || value < min) {
+		wlr_log(WLR_ERROR, "hwc2 mock: invalid %s '%s'", name, env);
+		return def;
+	}
+	return value;
+}
+
+static void mock_init_configs(struct hwc2_compat_display *display)
+{
+	int32_t width = MOCK_DEFAULT_WIDTH, height = MOCK_DEFAULT_HEIGHT;
+	const char *size_env = getenv("WLR_HWC_MOCK_SIZE");
+	if (size_env != NULL && (sscanf(size_env, "%" SCNd32 "x%" SCNd32,
+			&width, &height) != 2 || width <= 0 || height <= 0)) {
+		wlr_log(WLR_ERROR, "hwc2 mock: invalid WLR_HWC_MOCK_SIZE '%s'", size_env);
+		width = MOCK_DEFAULT_WIDTH;
+		height = MOCK_DEFAULT_HEIGHT;
+	}
+
+	// Comma-separated refresh rates, the first one being active
+	char rates[128] = "";
+	const char *refresh_env = getenv("WLR_HWC_MOCK_REFRESH");
+	snprintf(rates, sizeof(rates), "%s", refresh_env ? refresh_env : "");
+
+	char *saveptr = NULL;
+	for (char *rate = strtok_r(rates, ",", &saveptr);
+			rate != NULL && display->configs_len < MOCK_MAX_CONFIGS;
+			rate = strtok_r(NULL, ",", &saveptr)) {
+		char *end;
+		long hz = strtol(rate, &end, 10);
+		if (*end || hz <= 0) {
+			wlr_log(WLR_ERROR, "hwc2 mock: invalid refresh rate '%s'", rate);
+			continue;
+		}
+		display->configs[display->configs_len++].vsyncPeriod = 1000000000LL / hz;
+	}
+	if (display->configs_len == 0) {
+		display->configs[display->configs_len++].vsyncPeriod =
+			1000000000LL / MOCK_DEFAULT_REFRESH;
+	}
+
+	for (size_t i = 0; i < display->configs_len; i++) {
+		HWC2DisplayConfig *config = &display->configs[i];
+		config->id = i;
+		config->display = display->id;
+		config->width = width;
+		config->height = height;
+		config->dpiX = config->dpiY = 0;
+	}
+	display->active_config = 0;
+}
+
+static void mock_reset_stats(struct mock_stats *stats)
+{
+	int64_t last_present = stats->last_present;
+	memset(stats, 0, sizeof(*stats));
+	stats->latency_min = INT64_MAX;
+	stats->last_present = last_present;
+}
+
+static void mock_report_stats(struct hwc2_compat_display *display)
+{
+	struct mock_stats *stats = &display->stats;
+	if (stats->frames == 0) {
+		return;
+	}
+
+	char intervals[128] = "", latencies[128] = "";
+	size_t len = 0;
+	for (size_t i = 0; i < MOCK_INTERVAL_BUCKETS; i++) {
+		len += snprintf(intervals + len, sizeof(intervals) - len, " %s%zu:%zu",
+			i == MOCK_INTERVAL_BUCKETS - 1 ? ">=" : "", i + 1,
+			stats->intervals[i]);
+	}
+	len = 0;
+	for (size_t i = 0; i < MOCK_LATENCY_BUCKETS; i++) {
+		len += snprintf(latencies + len, sizeof(latencies) - len, " %zu",
+			stats->latencies[i]);
+	}
+
+	wlr_log(WLR_INFO, "hwc2 mock: display %" PRIu64 ": %zu frames, "
+		"%zu skipped vsyncs, %zu demoted layers, %zu damage rects",
+		display->id, stats->frames, stats->skipped_vsyncs,
+		stats->demoted_layers, stats->damage_rects);
+	wlr_log(WLR_INFO, "hwc2 mock: present intervals (vsyncs:frames):%s",
+		intervals);
+	wlr_log(WLR_INFO, "hwc2 mock: present latency after vsync: "
+		"min %" PRId64 " us, avg %" PRId64 " us, max %" PRId64 " us, "
+		"per 1/%d period:%s", stats->latency_min / 1000,
+		stats->latency_sum / (int64_t)stats->frames / 1000,
+		stats->latency_max / 1000, MOCK_LATENCY_BUCKETS, latencies);
+
+	mock_reset_stats(stats);
+}
+
+static void mock_record_present(struct hwc2_compat_display *display)
+{
+	struct hwc2_compat_device *device = display->device;
+	struct mock_stats *stats = &display->stats;
+	int64_t now = mock_get_time();
+	int64_t period = atomic_load(&device->vsync_period);
+	int64_t vsync = atomic_load(&device->vsync_last);
+
+	if (stats->last_present != 0) {
+		int64_t vsyncs = (now - stats->last_present + period / 2) / period;
+		if (vsyncs < 1) {
+			// Presented twice within the same period
+			vsyncs = 1;
+		}
+		stats->skipped_vsyncs += vsyncs - 1;
+		stats->intervals[vsyncs < MOCK_INTERVAL_BUCKETS ?
+			vsyncs - 1 : MOCK_INTERVAL_BUCKETS - 1]++;
+	}
+	stats->last_present = now;
+
+	int64_t latency = vsync != 0 ? now - vsync : 0;
+	if (latency < 0) {
+		latency = 0;
+	}
+	if (latency < stats->latency_min) {
+		stats->latency_min = latency;
+	}
+	if (latency > stats->latency_max) {
+		stats->latency_max = latency;
+	}
+	stats->latency_sum += latency;
+	int64_t bucket = latency * MOCK_LATENCY_BUCKETS / period;
+	stats->latencies[bucket < MOCK_LATENCY_BUCKETS ?
+		bucket : MOCK_LATENCY_BUCKETS - 1]++;
+
+	if (++stats->frames >= device->report_interval) {
+		mock_report_stats(display);
+	}
+}
+
+static int mock_create_present_fence(struct hwc2_compat_device *device)
+{
+	// The timeline is only advanced by the VSYNC thread
+	if (device->timeline_fd < 0 || !device->vsync_thread_started) {
+		return -1;
+	}
+
+	// Signaled by the next VSYNC. The count is incremented before the
+	// timeline, so the fence can't be signaled by the current one.
+	struct mock_sw_sync_create_fence_data data = {
+		.value = atomic_load(&device->vsync_count) + 1,
+	};
+	snprintf(data.name, sizeof(data.name), "hwc2-mock-present");
+	if (ioctl(device->timeline_fd, MOCK_SW_SYNC_IOC_CREATE_FENCE, &data) != 0) {
+		wlr_log(WLR_ERROR, "hwc2 mock: failed to create a present fence: %s",
+			strerror(errno));
+		return -1;
+	}
+	return data.fence;
+}
+
+static void *mock_vsync_thread(void *data)
+{
+	struct hwc2_compat_device *device = data;
+	struct hwc2_compat_display *display = &device->primary;
+	unsigned int seed = (unsigned int)mock_get_time();
+	int64_t next = mock_get_time();
+
+	while (true) {
+		int64_t period = atomic_load(&device->vsync_period);
+		next += period;
+
+		int64_t jitter = 0;
+		if (device->jitter > 0) {
+			jitter = (int64_t)(rand_r(&seed) % (2 * device->jitter + 1)) -
+				device->jitter;
+		}
+		int64_t timestamp = next + jitter;
+
+		struct timespec wakeup = {
+			.tv_sec = timestamp / 1000000000LL,
+			.tv_nsec = timestamp % 1000000000LL,
+		};
+		while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup,
+				NULL) == EINTR) {
+			// Sleep again
+		}
+
+		atomic_store(&device->vsync_last, timestamp);
+		atomic_fetch_add(&device->vsync_count, 1);
+		if (device->timeline_fd >= 0) {
+			uint32_t inc = 1;
+			ioctl(device->timeline_fd, MOCK_SW_SYNC_IOC_INC, &inc);
+		}
+		if (!atomic_load(&display->vsync_enabled)) {
+			continue;
+		}
+
+		if (device->vsync_2_4 != NULL) {
+			device->vsync_2_4(device->listener, device->vsync_2_4_sequence_id,
+				display->id, timestamp, period);
+		} else {
+			device->listener->on_vsync_received(device->listener,
+				device->sequence_id, display->id, timestamp);
+		}
+	}
+
+	return NULL;
+}
+
+hwc2_compat_device_t* hwc2_compat_device_new(bool use_vr_composer)
+{
+	struct hwc2_compat_device *device = calloc(1, sizeof(struct hwc2_compat_device));
+	if (device == NULL) {
+		return NULL;
+	}
+
+	device->jitter = mock_env_int("WLR_HWC_MOCK_JITTER", 0, 0) * 1000;
+	device->report_interval = mock_env_int("WLR_HWC_MOCK_REPORT",
+		MOCK_DEFAULT_REPORT, 1);
+
+	struct hwc2_compat_display *display = &device->primary;
+	display->device = device;
+	display->id = 0;
+	mock_init_configs(display);
+	mock_reset_stats(&display->stats);
+	display->max_device_layers = mock_env_int("WLR_HWC_MOCK_DEVICE_LAYERS",
+		INT64_MAX, 0);
+
+	atomic_init(&display->vsync_enabled, false);
+	atomic_init(&device->vsync_period,
+		display->configs[display->active_config].vsyncPeriod);
+	atomic_init(&device->vsync_last, 0);
+	atomic_init(&device->vsync_count, 0);
+
+	device->timeline_fd = open("/sys/kernel/debug/sync/sw_sync",
+		O_RDWR | O_CLOEXEC);
+	if (device->timeline_fd < 0) {
+		// Location on older Android kernels
+		device->timeline_fd = open("/dev/sw_sync", O_RDWR | O_CLOEXEC);
+	}
+	if (device->timeline_fd < 0) {
+		wlr_log(WLR_INFO, "hwc2 mock: sw_sync unavailable, presents "
+			"won't have fences");
+	}
+
+	wlr_log(WLR_INFO, "hwc2 mock: %" PRId32 "x%" PRId32 ", %zu configs, "
+		"jitter %" PRId64 " us", display->configs[0].width,
+		display->configs[0].height, display->configs_len, device->jitter / 1000);
+
+	return device;
+}
+
+void hwc2_compat_device_register_callback(hwc2_compat_device_t *device,
+		HWC2EventListener *listener, int composer_sequence_id)
+{
+	device->listener = listener;
+	device->sequence_id = composer_sequence_id;
+
+	// As with a real composer, the primary display is plugged during the
+	// registration
+	listener->on_hotplug_received(listener, composer_sequence_id,
+		device->primary.id, true, true);
+
+	if (!device->vsync_thread_started) {
+		if (pthread_create(&device->vsync_thread, NULL, mock_vsync_thread,
+				device) != 0) {
+			wlr_log(WLR_ERROR, "hwc2 mock: failed to start the vsync thread");
+			return;
+		}
+		pthread_detach(device->vsync_thread);
+		device->vsync_thread_started = true;
+	}
+}
+
+#if WLR_HAS_HWC2_COMPAT_DEVICE_REGISTER_VSYNC_2_4_CALLBACK
+void hwc2_compat_device_register_vsync_2_4_callback(hwc2_compat_device_t *device,
+		HWC2EventListener *listener, mock_vsync_2_4_func_t callback,
+		int32_t sequence_id)
+{
+	device->vsync_2_4_sequence_id = sequence_id;
+	device->vsync_2_4 = callback;
+}
+#endif
+
+void hwc2_compat_device_on_hotplug(hwc2_compat_device_t *device,
+		hwc2_display_t display_id, bool connected)
+{
+}
+
+hwc2_compat_display_t* hwc2_compat_device_get_display_by_id(
+		hwc2_compat_device_t *device, hwc2_display_t id)
+{
+	if (id != device->primary.id) {
+		return NULL;
+	}
+	return &device->primary;
+}
+
+void hwc2_compat_device_destroy_display(hwc2_compat_device_t *device,
+		hwc2_compat_display_t *display)
+{
+	atomic_store(&display->vsync_enabled, false);
+	mock_report_stats(display);
+}
+
+HWC2DisplayConfig* hwc2_compat_display_get_active_config(
+		hwc2_compat_display_t *display)
+{
+	HWC2DisplayConfig *config = malloc(sizeof(HWC2DisplayConfig));
+	if (config != NULL) {
+		*config = display->configs[display->active_config];
+	}
+	return config;
+}
+
+#if WLR_HAS_HWC2_COMPAT_DISPLAY_GET_CONFIGS
+HWC2DisplayConfig *hwc2_compat_display_get_configs(hwc2_compat_display_t *display,
+		size_t *configs_len)
+{
+	HWC2DisplayConfig *configs = calloc(display->configs_len, sizeof(HWC2DisplayConfig));
+	if (configs == NULL) {
+		return NULL;
+	}
+	memcpy(configs, display->configs, display->configs_len * sizeof(HWC2DisplayConfig));
+	*configs_len = display->configs_len;
+	return configs;
+}
+#endif
+
+#if WLR_HAS_HWC2_COMPAT_DISPLAY_SET_ACTIVE_CONFIG
+hwc2_error_t hwc2_compat_display_set_active_config(hwc2_compat_display_t *display,
+		uint32_t config_id)
+{
+	if (config_id >= display->configs_len) {
+		return HWC2_ERROR_BAD_CONFIG;
+	}
+
+	// Report the last period with the new rate, the present intervals
+	// would be meaningless across the switch
+	mock_report_stats(display);
+	display->stats.last_present = 0;
+
+	display->active_config = config_id;
+	atomic_store(&display->device->vsync_period,
+		display->configs[config_id].vsyncPeriod);
+	return HWC2_ERROR_NONE;
+}
+#endif
+
+hwc2_error_t hwc2_compat_display_accept_changes(hwc2_compat_display_t *display)
+{
+	for (struct hwc2_compat_layer *layer = display->layers; layer != NULL;
+			layer = layer->next) {
+		if (layer->demote) {
+			layer->composition_type = HWC2_COMPOSITION_CLIENT;
+			layer->demote = false;
+			display->stats.demoted_layers++;
+		}
+	}
+	display->validated = true;
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_compat_layer_t* hwc2_compat_display_create_layer(hwc2_compat_display_t *display)
+{
+	struct hwc2_compat_layer *layer = calloc(1, sizeof(struct hwc2_compat_layer));
+	if (layer == NULL) {
+		return NULL;
+	}
+	layer->display = display;
+	layer->composition_type = HWC2_COMPOSITION_CLIENT;
+	layer->next = display->layers;
+	display->layers = layer;
+	return layer;
+}
+
+void hwc2_compat_display_destroy_layer(hwc2_compat_display_t *display,
+		hwc2_compat_layer_t *layer)
+{
+	for (struct hwc2_compat_layer **link = &display->layers; *link != NULL;
+			link = &(*link)->next) {
+		if (*link == layer) {
+			*link = layer->next;
+			break;
+		}
+	}
+	free(layer);
+}
+
+hwc2_error_t hwc2_compat_display_get_release_fences(hwc2_compat_display_t *display,
+		hwc2_compat_out_fences_t **fences)
+{
+	*fences = calloc(1, sizeof(struct hwc2_compat_out_fences));
+	return *fences != NULL ? HWC2_ERROR_NONE : HWC2_ERROR_NO_RESOURCES;
+}
+
+hwc2_error_t hwc2_compat_display_present(hwc2_compat_display_t *display,
+		int32_t *present_fence)
+{
+	*present_fence = -1;
+
+	if (!display->validated) {
+		return HWC2_ERROR_NOT_VALIDATED;
+	}
+	display->validated = false;
+
+	if (display->powered) {
+		mock_record_present(display);
+		// Nothing is displayed, the frame counts as presented at the next
+		// VSYNC
+		*present_fence = mock_create_present_fence(display->device);
+	}
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_display_set_client_target(hwc2_compat_display_t *display,
+		uint32_t slot, struct ANativeWindowBuffer *buffer,
+		const int32_t acquire_fence_fd, int dataspace)
+{
+	// The composer owns the fence
+	if (acquire_fence_fd >= 0) {
+		close(acquire_fence_fd);
+	}
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_display_set_power_mode(hwc2_compat_display_t *display,
+		int mode)
+{
+	display->powered = mode != HWC2_POWER_MODE_OFF;
+	if (!display->powered) {
+		display->stats.last_present = 0;
+	}
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_display_set_vsync_enabled(hwc2_compat_display_t *display,
+		int enabled)
+{
+	atomic_store(&display->vsync_enabled, enabled == HWC2_VSYNC_ENABLE);
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_display_validate(hwc2_compat_display_t *display,
+		uint32_t *num_types, uint32_t *num_requests)
+{
+	size_t device_len = 0;
+	for (struct hwc2_compat_layer *layer = display->layers; layer != NULL;
+			layer = layer->next) {
+		layer->demote = false;
+		if (layer->composition_type == HWC2_COMPOSITION_DEVICE) {
+			device_len++;
+		}
+	}
+
+	// Demote the bottom device layers in excess
+	*num_types = 0;
+	*num_requests = 0;
+	while (device_len > display->max_device_layers) {
+		struct hwc2_compat_layer *bottom = NULL;
+		for (struct hwc2_compat_layer *layer = display->layers; layer != NULL;
+				layer = layer->next) {
+			if (layer->composition_type == HWC2_COMPOSITION_DEVICE &&
+					!layer->demote &&
+					(bottom == NULL || layer->z_order < bottom->z_order)) {
+				bottom = layer;
+			}
+		}
+		bottom->demote = true;
+		device_len--;
+		(*num_types)++;
+	}
+
+	// As with a real composer, changes have to be accepted before
+	// presenting
+	display->validated = *num_types == 0;
+	return *num_types == 0 ? HWC2_ERROR_NONE : HWC2_ERROR_HAS_CHANGES;
+}
+
+hwc2_error_t hwc2_compat_display_present_or_validate(hwc2_compat_display_t *display,
+		uint32_t *num_types, uint32_t *num_requests, int32_t *present_fence,
+		uint32_t *state)
+{
+	*present_fence = -1;
+	hwc2_error_t error = hwc2_compat_display_validate(display, num_types,
+		num_requests);
+	if (error != HWC2_ERROR_NONE) {
+		*state = 0; // Validated
+		return error;
+	}
+	*state = 1; // Presented
+	return hwc2_compat_display_present(display, present_fence);
+}
+
+hwc2_error_t hwc2_compat_layer_set_buffer(hwc2_compat_layer_t *layer,
+		uint32_t slot, struct ANativeWindowBuffer *buffer,
+		const int32_t acquire_fence_fd)
+{
+	if (acquire_fence_fd >= 0) {
+		close(acquire_fence_fd);
+	}
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_blend_mode(hwc2_compat_layer_t *layer, int mode)
+{
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_color(hwc2_compat_layer_t *layer, void *color)
+{
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_composition_type(hwc2_compat_layer_t *layer,
+		int type)
+{
+	layer->composition_type = type;
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_dataspace(hwc2_compat_layer_t *layer,
+		int dataspace)
+{
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_display_frame(hwc2_compat_layer_t *layer,
+		int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_plane_alpha(hwc2_compat_layer_t *layer,
+		float alpha)
+{
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_sideband_stream(hwc2_compat_layer_t *layer,
+		void *stream)
+{
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_source_crop(hwc2_compat_layer_t *layer,
+		float left, float top, float right, float bottom)
+{
+	return HWC2_ERROR_NONE;
+}
+
+#if WLR_HAS_HWC2_COMPAT_LAYER_SET_SURFACE_DAMAGE
+hwc2_error_t hwc2_compat_layer_set_surface_damage(hwc2_compat_layer_t *layer,
+		hwc_region_t damage)
+{
+	if (damage.numRects > 0 && damage.rects == NULL) {
+		return HWC2_ERROR_BAD_PARAMETER;
+	}
+	layer->display->stats.damage_rects += damage.numRects;
+	return HWC2_ERROR_NONE;
+}
+#endif
+
+hwc2_error_t hwc2_compat_layer_set_transform(hwc2_compat_layer_t *layer,
+		int transform)
+{
+	return HWC2_ERROR_NONE;
+}
+
+hwc2_error_t hwc2_compat_layer_set_visible_region(hwc2_compat_layer_t *layer,
+		int32_t left, int32_t top, int32_t right, int32_t bottom)
+{
+	return HWC2_ERROR_NONE;
+}
+
+#if WLR_HAS_HWC2_COMPAT_LAYER_SET_Z_ORDER
+hwc2_error_t hwc2_compat_layer_set_z_order(hwc2_compat_layer_t *layer, uint32_t z)
+{
+	layer->z_order = z;
+	return HWC2_ERROR_NONE;
+}
+#endif
+
+int32_t hwc2_compat_out_fences_get_fence(hwc2_compat_out_fences_t *fences,
+		hwc2_compat_layer_t *layer)
+{
+	return -1;
+}
+
+void hwc2_compat_out_fences_destroy(hwc2_compat_out_fences_t *fences)
+{
+	free(fences);
+}
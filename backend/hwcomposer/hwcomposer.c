@@ -57,12 +57,12 @@ static bool hwcomposer_vsync_control(struct wlr_hwcomposer_output *output, bool
 	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
 	struct wlr_hwcomposer_backend_hwc1 *hwc1 = hwc1_backend_from_base(hwc_backend);
 
-	if (hwc_backend->hwc_vsync_enabled == enable) {
+	if (output->hwc_vsync_enabled == enable) {
 		return true;
 	}
 
 	if (hwc1->hwc_device_ptr->eventControl(hwc1->hwc_device_ptr, 0, HWC_EVENT_VSYNC, enable ? 1 : 0)) {
-		hwc_backend->hwc_vsync_enabled = enable;
+		output->hwc_vsync_enabled = enable;
 
 		return true;
 	}
@@ -231,11 +231,6 @@ static struct wlr_hwcomposer_output* hwcomposer_add_output(struct wlr_hwcomposer
 	list->flags = HWC_GEOMETRY_CHANGED;
 	list->numHwLayers = 2;
 
-	// FIXME: This being here is wrong
-	if (hwc1_output->output.hwc_is_primary) {
-		hwc1->hwc_backend.hwc_device_refresh = hwc1_output->output.hwc_refresh;
-	}
-
 	return &hwc1_output->output;
 }
 
@@ -5,6 +5,7 @@
 #include <math.h>
 #include <stddef.h>
 #include <malloc.h>
+#include <pthread.h>
 #include <sys/cdefs.h> // for __BEGIN_DECLS/__END_DECLS found in sync.h
 #include <sync/sync.h>
 
@@ -12,12 +13,19 @@
 
 #include <hybris/hwc2/hwc2_compatibility_layer.h>
 
+#include <wlr/config.h>
 #include <wlr/util/log.h>
 #include <wlr/interfaces/wlr_output.h>
+#include <wlr/types/wlr_buffer.h>
 
 #include "backend/hwcomposer.h"
 
 #ifdef HWC_DEVICE_API_VERSION_2_0
+// HWC 2.4 entry points, only exported by some libhybris versions. The
+// display keeps its single config without them.
+#define HWC2_HAS_DISPLAY_CONFIGS (WLR_HAS_HWC2_COMPAT_DISPLAY_GET_CONFIGS && \
+	WLR_HAS_HWC2_COMPAT_DISPLAY_SET_ACTIVE_CONFIG)
+
 typedef struct
 {
 	struct HWC2EventListener listener;
@@ -31,15 +39,33 @@ struct wlr_hwcomposer_backend_hwc2
 	struct wlr_hwcomposer_backend hwc_backend;
 
 	hwc2_compat_device_t *hwc2_device;
+
+	// Outputs the VSYNC callbacks are routed to by display id. The
+	// callbacks are called from a binder thread, hence the lock.
+	struct wl_list hwc2_outputs; // wlr_hwcomposer_output_hwc2::hwc2_link
+	pthread_mutex_t hwc2_outputs_lock;
 };
 
 struct wlr_hwcomposer_output_hwc2
 {
 	struct wlr_hwcomposer_output output;
+	struct wl_list hwc2_link; // wlr_hwcomposer_backend_hwc2::hwc2_outputs
 
 	hwc2_compat_display_t *hwc2_display;
 	hwc2_compat_layer_t *hwc2_layer;
-	int hwc2_last_present_fence;
+
+	// Whether the layer is presented by the device, instead of being
+	// composited by the client into the client target
+	bool hwc2_layer_device;
+	// Buffer last presented by the device on hwc2_layer, NULL if the layer
+	// is composited by the client
+	struct ANativeWindowBuffer *hwc2_layer_buffer;
+
+	// Layers stacked above hwc2_layer. The bottom ones, up to
+	// hwc2_overlays_client_len, are composited by the client.
+	hwc2_compat_layer_t **hwc2_overlays;
+	size_t hwc2_overlays_len;
+	size_t hwc2_overlays_client_len;
 };
 
 static struct wlr_hwcomposer_backend_hwc2 *hwc2_backend_from_base(struct wlr_hwcomposer_backend *hwc_backend)
@@ -54,14 +80,40 @@ static struct wlr_hwcomposer_output_hwc2 *hwc2_output_from_base(struct wlr_hwcom
 	return (struct wlr_hwcomposer_output_hwc2 *)output;
 }
 
+static void hwcomposer2_handle_vsync(struct wlr_hwcomposer_backend_hwc2 *hwc2,
+		hwc2_display_t display, int64_t timestamp, int64_t vsync_period_nanos)
+{
+	struct wlr_hwcomposer_output_hwc2 *hwc2_output;
+
+	pthread_mutex_lock(&hwc2->hwc2_outputs_lock);
+	wl_list_for_each(hwc2_output, &hwc2->hwc2_outputs, hwc2_link) {
+		if (hwc2_output->output.hwc_display_id == display) {
+			atomic_store(&hwc2_output->output.hwc_vsync_last_timestamp, timestamp);
+			atomic_store(&hwc2_output->output.hwc_vsync_period, vsync_period_nanos);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&hwc2->hwc2_outputs_lock);
+}
+
 static void hwcomposer2_vsync_callback(HWC2EventListener* listener, int32_t sequence_id,
 		hwc2_display_t display, int64_t timestamp)
 {
 	struct wlr_hwcomposer_backend_hwc2 *hwc2 = ((hwc_procs_v20 *)listener)->hwc2;
 
-	hwc2->hwc_backend.hwc_vsync_last_timestamp = timestamp;
+	hwcomposer2_handle_vsync(hwc2, display, timestamp, 0);
 }
 
+#if WLR_HAS_HWC2_COMPAT_DEVICE_REGISTER_VSYNC_2_4_CALLBACK
+static void hwcomposer2_vsync_2_4_callback(HWC2EventListener* listener, int32_t sequence_id,
+		hwc2_display_t display, int64_t timestamp, int64_t vsync_period_nanos)
+{
+	struct wlr_hwcomposer_backend_hwc2 *hwc2 = ((hwc_procs_v20 *)listener)->hwc2;
+
+	hwcomposer2_handle_vsync(hwc2, display, timestamp, vsync_period_nanos);
+}
+#endif
+
 static void hwcomposer2_hotplug_callback(HWC2EventListener* listener, int32_t sequence_id,
 		hwc2_display_t display, bool connected,
 		bool primary_display)
@@ -98,6 +150,9 @@ struct wlr_hwcomposer_backend* hwcomposer2_api_init(hw_device_t *hwc_device)
 	hwc2_compat_device_t* hwc2_device = hwc2->hwc2_device = hwc2_compat_device_new(false);
 	assert(hwc2_device);
 
+	wl_list_init(&hwc2->hwc2_outputs);
+	pthread_mutex_init(&hwc2->hwc2_outputs_lock, NULL);
+
 	hwc2->hwc_backend.impl = &hwcomposer_hwc2;
 
 	return &hwc2->hwc_backend;
@@ -108,19 +163,18 @@ static void hwcomposer2_close(struct wlr_hwcomposer_backend *hwc_backend)
 
 static bool hwcomposer2_vsync_control(struct wlr_hwcomposer_output *output, bool enable)
 {
-	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
 	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
 
 	wlr_log(WLR_DEBUG, "hwcomposer2: vsync_control: display %p, enable %d",
 		hwc2_output->hwc2_display, enable);
 
-	if (!output->hwc_is_primary || hwc_backend->hwc_vsync_enabled == enable) {
+	if (output->hwc_vsync_enabled == enable) {
 		return true;
 	}
 
 	if (hwc2_compat_display_set_vsync_enabled(hwc2_output->hwc2_display, enable ?
 		HWC2_VSYNC_ENABLE : HWC2_VSYNC_DISABLE) == HWC2_ERROR_NONE) {
-		hwc_backend->hwc_vsync_enabled = enable;
+		output->hwc_vsync_enabled = enable;
 
 		return true;
 	}
@@ -149,14 +203,69 @@ static bool hwcomposer2_set_power_mode(struct wlr_hwcomposer_output *output, boo
 	return false;
 }
 
+static void hwcomposer2_set_layer_device(struct wlr_hwcomposer_output_hwc2 *hwc2_output,
+		bool device)
+{
+	if (hwc2_output->hwc2_layer_device == device) {
+		return;
+	}
+
+	hwc2_compat_layer_set_composition_type(hwc2_output->hwc2_layer, device ?
+		HWC2_COMPOSITION_DEVICE : HWC2_COMPOSITION_CLIENT);
+	hwc2_output->hwc2_layer_device = device;
+}
+
+static void hwcomposer2_finish_present(struct wlr_hwcomposer_output_hwc2 *hwc2_output,
+		int present_fence)
+{
+	struct wlr_hwcomposer_output *output = &hwc2_output->output;
+
+	// Waited for from the event loop to timestamp the presentation of the
+	// frame, never on the compositor thread
+	if (output->present_fence_fd != -1) {
+		close(output->present_fence_fd);
+	}
+	output->present_fence_fd = present_fence != -1 ? dup(present_fence) : -1;
+}
+
+// libhybris doesn't tell which layers the device can't handle, only how
+// many: validate the display, handing the bottom device overlay back to the
+// client until the device accepts the configuration, which keeps the client
+// layers below the device ones. num_types is left to the number of
+// composition changes the device still asks for.
+static hwc2_error_t hwcomposer2_validate_overlays(struct wlr_hwcomposer_output_hwc2 *hwc2_output,
+		uint32_t *num_types)
+{
+	while (true) {
+		uint32_t num_requests = 0;
+		*num_types = 0;
+		hwc2_error_t error = hwc2_compat_display_validate(hwc2_output->hwc2_display,
+			num_types, &num_requests);
+		if (error != HWC2_ERROR_HAS_CHANGES) {
+			return error;
+		}
+		if (*num_types == 0 ||
+				hwc2_output->hwc2_overlays_client_len == hwc2_output->hwc2_overlays_len) {
+			return error;
+		}
+
+		hwc2_compat_layer_set_composition_type(
+			hwc2_output->hwc2_overlays[hwc2_output->hwc2_overlays_client_len++],
+			HWC2_COMPOSITION_CLIENT);
+	}
+}
+
 static void hwcomposer2_present(void *user_data, struct ANativeWindow *window,
 		struct ANativeWindowBuffer *buffer)
 {
 	struct wlr_hwcomposer_output *output = (struct wlr_hwcomposer_output *)user_data;
 	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
 
+	// The buffer has been composited by the client
+	hwcomposer2_set_layer_device(hwc2_output, false);
+	hwc2_output->hwc2_layer_buffer = NULL;
+
 	uint32_t num_types = 0;
-	uint32_t num_requests = 0;
 	hwc2_error_t error = HWC2_ERROR_NONE;
 
 	int acquireFenceFd = HWCNativeBufferGetFence(buffer);
@@ -170,20 +279,24 @@ static void hwcomposer2_present(void *user_data, struct ANativeWindow *window,
 
 	hwc2_compat_display_t* hwc_display = hwc2_output->hwc2_display;
 
-	error = hwc2_compat_display_validate(hwc_display, &num_types,
-		&num_requests);
+	// Overlays the device rejects now are missing from this frame, as the
+	// client target has already been rendered without them, until the
+	// compositor sets its layers again
+	size_t client_len = hwc2_output->hwc2_overlays_client_len;
+	error = hwcomposer2_validate_overlays(hwc2_output, &num_types);
 	if (error != HWC2_ERROR_NONE && error != HWC2_ERROR_HAS_CHANGES) {
 		wlr_log(WLR_ERROR, "prepare: validate failed for display %ld: %d",
 			output->hwc_display_id, error);
 		return;
 	}
-
-	if ((error == HWC2_ERROR_HAS_CHANGES && num_types) || num_requests) {
-		wlr_log(WLR_ERROR, "prepare: validate required changes for display %ld: %d",
-			output->hwc_display_id, error);
-		return;
+	if (hwc2_output->hwc2_overlays_client_len > client_len) {
+		wlr_log(WLR_DEBUG, "prepare: display %ld rejected %zu overlays",
+			output->hwc_display_id,
+			hwc2_output->hwc2_overlays_client_len - client_len);
 	}
 
+	// Whatever the device still wants to change only concerns the client
+	// target, which is composited by the client anyway
 	error = hwc2_compat_display_accept_changes(hwc_display);
 	if (error != HWC2_ERROR_NONE) {
 		wlr_log(WLR_ERROR, "prepare: acceptChanges failed: %d", error);
@@ -197,14 +310,299 @@ static void hwcomposer2_present(void *user_data, struct ANativeWindow *window,
 	int present_fence = -1;
 	hwc2_compat_display_present(hwc_display, &present_fence);
 
-	if (hwc2_output->hwc2_last_present_fence != -1) {
-		sync_wait(hwc2_output->hwc2_last_present_fence, -1);
-		close(hwc2_output->hwc2_last_present_fence);
+	hwcomposer2_finish_present(hwc2_output, present_fence);
+
+	HWCNativeBufferSetFence(buffer, present_fence);
+}
+
+// Only exported by some libhybris versions, the whole client target is
+// assumed damaged without it
+#if WLR_HAS_HWC2_COMPAT_LAYER_SET_SURFACE_DAMAGE
+static void hwcomposer2_set_damage(struct wlr_hwcomposer_output *output,
+		pixman_region32_t *damage)
+{
+	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
+
+	// An empty region means the whole layer is damaged
+	hwc_region_t region = { .numRects = 0, .rects = NULL };
+	hwc_rect_t *rects = NULL;
+	int nrects = 0;
+	if (damage != NULL) {
+		pixman_box32_t *boxes = pixman_region32_rectangles(damage, &nrects);
+		rects = calloc(nrects > 0 ? nrects : 1, sizeof(hwc_rect_t));
+		if (rects == NULL) {
+			wlr_log(WLR_ERROR, "Allocation failed");
+			nrects = 0;
+		}
+		for (int i = 0; i < nrects; i++) {
+			rects[i] = (hwc_rect_t){
+				.left = boxes[i].x1,
+				.top = boxes[i].y1,
+				.right = boxes[i].x2,
+				.bottom = boxes[i].y2,
+			};
+		}
+		region.numRects = nrects;
+		region.rects = rects;
 	}
 
-	hwc2_output->hwc2_last_present_fence = present_fence != -1 ? dup(present_fence) : -1;
+	hwc2_error_t error = hwc2_compat_layer_set_surface_damage(hwc2_output->hwc2_layer,
+		region);
+	if (error != HWC2_ERROR_NONE) {
+		wlr_log(WLR_DEBUG, "hwcomposer2: set_damage failed for display %ld: %d",
+			output->hwc_display_id, error);
+	}
 
-	HWCNativeBufferSetFence(buffer, present_fence);
+	free(rects);
+}
+#endif
+
+static int32_t hwcomposer2_transform(enum wl_output_transform transform)
+{
+	// wl_output transforms rotate counter-clockwise, HWC ones clockwise
+	switch (transform) {
+	case WL_OUTPUT_TRANSFORM_NORMAL:
+		return 0;
+	case WL_OUTPUT_TRANSFORM_90:
+		return HWC_TRANSFORM_ROT_270;
+	case WL_OUTPUT_TRANSFORM_180:
+		return HWC_TRANSFORM_ROT_180;
+	case WL_OUTPUT_TRANSFORM_270:
+		return HWC_TRANSFORM_ROT_90;
+	case WL_OUTPUT_TRANSFORM_FLIPPED:
+		return HWC_TRANSFORM_FLIP_H;
+	case WL_OUTPUT_TRANSFORM_FLIPPED_90:
+		return HWC_TRANSFORM_FLIP_V | HWC_TRANSFORM_ROT_90;
+	case WL_OUTPUT_TRANSFORM_FLIPPED_180:
+		return HWC_TRANSFORM_FLIP_V;
+	case WL_OUTPUT_TRANSFORM_FLIPPED_270:
+		return HWC_TRANSFORM_FLIP_H | HWC_TRANSFORM_ROT_90;
+	}
+	abort();
+}
+
+static bool hwcomposer2_resize_overlays(struct wlr_hwcomposer_output_hwc2 *hwc2_output,
+		size_t len)
+{
+	hwc2_compat_display_t *hwc_display = hwc2_output->hwc2_display;
+
+	while (hwc2_output->hwc2_overlays_len > len) {
+		hwc2_compat_display_destroy_layer(hwc_display,
+			hwc2_output->hwc2_overlays[--hwc2_output->hwc2_overlays_len]);
+	}
+	if (hwc2_output->hwc2_overlays_len == len) {
+		return true;
+	}
+
+	hwc2_compat_layer_t **overlays = realloc(hwc2_output->hwc2_overlays,
+		len * sizeof(hwc2_compat_layer_t *));
+	if (overlays == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+	hwc2_output->hwc2_overlays = overlays;
+
+	while (hwc2_output->hwc2_overlays_len < len) {
+		hwc2_compat_layer_t *layer = hwc2_compat_display_create_layer(hwc_display);
+		if (layer == NULL) {
+			wlr_log(WLR_ERROR, "hwcomposer2: failed to create layer");
+			return false;
+		}
+		overlays[hwc2_output->hwc2_overlays_len++] = layer;
+	}
+
+	return true;
+}
+
+static void hwcomposer2_close_fences(int *fences, size_t len)
+{
+	for (size_t i = 0; i < len; i++) {
+		if (fences[i] != -1) {
+			close(fences[i]);
+		}
+	}
+}
+
+static bool hwcomposer2_set_layers(struct wlr_hwcomposer_output *output,
+		struct wlr_hwcomposer_layer *layers, struct ANativeWindowBuffer **buffers,
+		int *acquire_fences, size_t layers_len)
+{
+#if WLR_HAS_HWC2_COMPAT_LAYER_SET_Z_ORDER
+	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
+
+	if (!hwcomposer2_resize_overlays(hwc2_output, layers_len)) {
+		hwcomposer2_resize_overlays(hwc2_output, 0);
+		hwcomposer2_close_fences(acquire_fences, layers_len);
+		return false;
+	}
+
+	hwc2_output->hwc2_overlays_client_len = 0;
+	if (layers_len == 0) {
+		return true;
+	}
+
+	// Layers composited by the client end up in the client target, at the
+	// bottom of the stack: every layer below one of them has to be
+	// composited by the client too. The layers below the topmost one which
+	// can't be imported are handed to the client right away.
+	size_t client_len = 0;
+	for (size_t i = 0; i < layers_len; i++) {
+		if (buffers[i] == NULL) {
+			client_len = i + 1;
+		}
+	}
+
+	hwc2_compat_layer_set_z_order(hwc2_output->hwc2_layer, 0);
+
+	for (size_t i = 0; i < layers_len; i++) {
+		struct wlr_hwcomposer_layer *layer = &layers[i];
+		hwc2_compat_layer_t *hwc2_layer = hwc2_output->hwc2_overlays[i];
+		struct wlr_box *box = &layer->dst_box;
+
+		hwc2_compat_layer_set_z_order(hwc2_layer, i + 1);
+		hwc2_compat_layer_set_blend_mode(hwc2_layer, HWC2_BLEND_MODE_PREMULTIPLIED);
+		hwc2_compat_layer_set_plane_alpha(hwc2_layer, layer->alpha);
+		hwc2_compat_layer_set_display_frame(hwc2_layer, box->x, box->y,
+			box->x + box->width, box->y + box->height);
+		hwc2_compat_layer_set_visible_region(hwc2_layer, box->x, box->y,
+			box->x + box->width, box->y + box->height);
+
+		if (i < client_len) {
+			hwc2_compat_layer_set_composition_type(hwc2_layer, HWC2_COMPOSITION_CLIENT);
+			if (acquire_fences[i] != -1) {
+				close(acquire_fences[i]);
+			}
+			continue;
+		}
+
+		hwc2_compat_layer_set_transform(hwc2_layer,
+			hwcomposer2_transform(layer->transform));
+		hwc2_compat_layer_set_source_crop(hwc2_layer, 0.0f, 0.0f,
+			layer->buffer->width, layer->buffer->height);
+		hwc2_compat_layer_set_buffer(hwc2_layer, /* slot */0, buffers[i],
+			acquire_fences[i]);
+		hwc2_compat_layer_set_composition_type(hwc2_layer, HWC2_COMPOSITION_DEVICE);
+		layer->composition = WLR_HWCOMPOSER_COMPOSITION_DEVICE;
+	}
+
+	hwc2_output->hwc2_overlays_client_len = client_len;
+	uint32_t num_types = 0;
+	hwc2_error_t error = hwcomposer2_validate_overlays(hwc2_output, &num_types);
+	if (error != HWC2_ERROR_NONE && error != HWC2_ERROR_HAS_CHANGES) {
+		wlr_log(WLR_DEBUG, "hwcomposer2: validate failed for display %ld: %d",
+			output->hwc_display_id, error);
+		while (hwc2_output->hwc2_overlays_client_len < layers_len) {
+			hwc2_compat_layer_set_composition_type(
+				hwc2_output->hwc2_overlays[hwc2_output->hwc2_overlays_client_len++],
+				HWC2_COMPOSITION_CLIENT);
+		}
+	}
+	client_len = hwc2_output->hwc2_overlays_client_len;
+	for (size_t i = 0; i < client_len; i++) {
+		layers[i].composition = WLR_HWCOMPOSER_COMPOSITION_CLIENT;
+	}
+
+	return client_len < layers_len;
+#else
+	// Layers can't be stacked above the client target without z-order
+	if (layers_len > 0) {
+		wlr_log(WLR_DEBUG, "hwcomposer2: layers can't be ordered, "
+			"libhybris lacks hwc2_compat_layer_set_z_order");
+	}
+	hwcomposer2_close_fences(acquire_fences, layers_len);
+	return false;
+#endif
+}
+
+static bool hwcomposer2_validate_scanout(struct wlr_hwcomposer_output_hwc2 *hwc2_output,
+		struct ANativeWindowBuffer *buffer, int acquire_fence)
+{
+	struct wlr_hwcomposer_output *output = &hwc2_output->output;
+	hwc2_compat_display_t *hwc_display = hwc2_output->hwc2_display;
+
+	hwcomposer2_set_layer_device(hwc2_output, true);
+	// The device waits for the client to be done rendering into the buffer
+	hwc2_compat_layer_set_buffer(hwc2_output->hwc2_layer, /* slot */0, buffer,
+		acquire_fence);
+
+	uint32_t num_types = 0;
+	uint32_t num_requests = 0;
+	hwc2_error_t error = hwc2_compat_display_validate(hwc_display, &num_types,
+		&num_requests);
+	if (error != HWC2_ERROR_NONE && error != HWC2_ERROR_HAS_CHANGES) {
+		wlr_log(WLR_DEBUG, "scanout: validate failed for display %ld: %d",
+			output->hwc_display_id, error);
+		return false;
+	}
+
+	// There is no client target to fall back to: a layer changing its
+	// composition type means the buffer can't be scanned out. Requests are
+	// only hints, and accepted along with the changes.
+	if (error == HWC2_ERROR_HAS_CHANGES && num_types) {
+		wlr_log(WLR_DEBUG, "scanout: display %ld requires client composition",
+			output->hwc_display_id);
+		return false;
+	}
+
+	return true;
+}
+
+static bool hwcomposer2_test_scanout(struct wlr_hwcomposer_output *output,
+		struct ANativeWindowBuffer *buffer)
+{
+	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
+
+	// The buffer isn't presented, it doesn't need to be complete yet
+	bool ok = hwcomposer2_validate_scanout(hwc2_output, buffer, -1);
+
+	// Put the layer back the way the last present left it. The display
+	// still has to be validated again before the next present, which both
+	// present paths do.
+	bool device = hwc2_output->hwc2_layer_buffer != NULL;
+	hwcomposer2_set_layer_device(hwc2_output, device);
+	if (device) {
+		// Already waited for by the device when it was presented
+		hwc2_compat_layer_set_buffer(hwc2_output->hwc2_layer, /* slot */0,
+			hwc2_output->hwc2_layer_buffer, -1);
+	}
+
+	return ok;
+}
+
+static bool hwcomposer2_present_scanout(struct wlr_hwcomposer_output *output,
+		struct ANativeWindowBuffer *buffer, int acquire_fence)
+{
+	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
+	hwc2_compat_display_t *hwc_display = hwc2_output->hwc2_display;
+
+	// The display must be validated right before being presented
+	if (!hwcomposer2_validate_scanout(hwc2_output, buffer, acquire_fence)) {
+		hwcomposer2_set_layer_device(hwc2_output, false);
+		hwc2_output->hwc2_layer_buffer = NULL;
+		return false;
+	}
+
+	hwc2_error_t error = hwc2_compat_display_accept_changes(hwc_display);
+	if (error != HWC2_ERROR_NONE) {
+		wlr_log(WLR_ERROR, "scanout: acceptChanges failed: %d", error);
+		return false;
+	}
+
+	int present_fence = -1;
+	error = hwc2_compat_display_present(hwc_display, &present_fence);
+	if (error != HWC2_ERROR_NONE) {
+		wlr_log(WLR_ERROR, "scanout: present failed for display %ld: %d",
+			output->hwc_display_id, error);
+		return false;
+	}
+
+	hwc2_output->hwc2_layer_buffer = buffer;
+	hwcomposer2_finish_present(hwc2_output, present_fence);
+	if (present_fence != -1) {
+		close(present_fence);
+	}
+
+	return true;
 }
 
 static struct wlr_hwcomposer_output* hwcomposer2_add_output(struct wlr_hwcomposer_backend *hwc_backend, int display)
@@ -246,21 +644,110 @@ static struct wlr_hwcomposer_output* hwcomposer2_add_output(struct wlr_hwcompose
 	hwc2_compat_layer_set_display_frame(layer, 0, 0, hwc2_output->output.hwc_width, hwc2_output->output.hwc_height);
 	hwc2_compat_layer_set_visible_region(layer, 0, 0, hwc2_output->output.hwc_width, hwc2_output->output.hwc_height);
 
-	hwc2_output->hwc2_last_present_fence = -1;
+	// The display id is only set by the caller
+	hwc2_output->output.hwc_display_id = display;
+	pthread_mutex_lock(&hwc2->hwc2_outputs_lock);
+	wl_list_insert(&hwc2->hwc2_outputs, &hwc2_output->hwc2_link);
+	pthread_mutex_unlock(&hwc2->hwc2_outputs_lock);
+
+	return &hwc2_output->output;
+}
+
+#if HWC2_HAS_DISPLAY_CONFIGS
+static void hwcomposer2_add_modes(struct wlr_hwcomposer_output *output)
+{
+	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
 
-	// FIXME: This being here is wrong
-	if (hwc2_output->output.hwc_is_primary) {
-		hwc2->hwc_backend.hwc_device_refresh = hwc2_output->output.hwc_refresh;
+	// Allocated with malloc, like the active config
+	size_t configs_len = 0;
+	HWC2DisplayConfig *configs =
+		hwc2_compat_display_get_configs(hwc2_output->hwc2_display, &configs_len);
+	if (configs == NULL) {
+		return;
 	}
 
-	return &hwc2_output->output;
+	HWC2DisplayConfig *active = hwc2_compat_display_get_active_config(hwc2_output->hwc2_display);
+
+	for (size_t i = 0; i < configs_len; i++) {
+		HWC2DisplayConfig *config = &configs[i];
+
+		// Every mode must fit the native window, only the refresh rate
+		// can be switched
+		if (config->width != output->hwc_width ||
+				config->height != output->hwc_height ||
+				config->vsyncPeriod <= 0) {
+			continue;
+		}
+
+		int32_t refresh = 1000000000000LL / config->vsyncPeriod;
+		bool is_active = active != NULL && config->id == active->id;
+
+		// Configs may only differ by properties we don't expose, keep a
+		// single one per refresh rate, favouring the active one
+		struct wlr_hwcomposer_mode *mode = NULL, *iter;
+		wl_list_for_each(iter, &output->wlr_output.modes, wlr_mode.link) {
+			if (iter->wlr_mode.refresh == refresh) {
+				mode = iter;
+				break;
+			}
+		}
+		if (mode != NULL) {
+			if (is_active) {
+				mode->wlr_mode.preferred = true;
+				mode->hwc_config_id = config->id;
+			}
+			continue;
+		}
+
+		mode = calloc(1, sizeof(struct wlr_hwcomposer_mode));
+		if (mode == NULL) {
+			wlr_log(WLR_ERROR, "Failed to allocate wlr_hwcomposer_mode");
+			break;
+		}
+		mode->wlr_mode.width = config->width;
+		mode->wlr_mode.height = config->height;
+		mode->wlr_mode.refresh = refresh;
+		mode->wlr_mode.preferred = is_active;
+		mode->hwc_config_id = config->id;
+		wl_list_insert(output->wlr_output.modes.prev, &mode->wlr_mode.link);
+
+		wlr_log(WLR_INFO, "hwcomposer2: display %ld config %" PRIu32 ": %dx%d@%d%s",
+			output->hwc_display_id, mode->hwc_config_id, config->width,
+			config->height, refresh, is_active ? " (active)" : "");
+	}
+
+	free(active);
+	free(configs);
+}
+
+static bool hwcomposer2_set_mode(struct wlr_hwcomposer_output *output,
+		struct wlr_hwcomposer_mode *mode)
+{
+	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
+
+	hwc2_error_t error = hwc2_compat_display_set_active_config(hwc2_output->hwc2_display,
+		mode->hwc_config_id);
+	if (error != HWC2_ERROR_NONE) {
+		wlr_log(WLR_ERROR, "hwcomposer2: set_mode: setActiveConfig failed: %d", error);
+		return false;
+	}
+
+	return true;
 }
+#endif
 
 static void hwcomposer2_destroy_output(struct wlr_hwcomposer_output *output)
 {
 	struct wlr_hwcomposer_output_hwc2 *hwc2_output = hwc2_output_from_base(output);
 	struct wlr_hwcomposer_backend_hwc2 *hwc2 = hwc2_backend_from_base(output->hwc_backend);
 
+	pthread_mutex_lock(&hwc2->hwc2_outputs_lock);
+	wl_list_remove(&hwc2_output->hwc2_link);
+	pthread_mutex_unlock(&hwc2->hwc2_outputs_lock);
+
+	hwcomposer2_resize_overlays(hwc2_output, 0);
+	free(hwc2_output->hwc2_overlays);
+
 	hwc2_compat_device_destroy_display(hwc2->hwc2_device, hwc2_output->hwc2_display);
 
 	free(hwc2_output);
@@ -280,12 +767,30 @@ static void hwcomposer2_register_callbacks(struct wlr_hwcomposer_backend *hwc_ba
 	hwc2_compat_device_register_callback(hwc2->hwc2_device, &procs->listener,
 		composer_sequence_id++);
 
+#if WLR_HAS_HWC2_COMPAT_DEVICE_REGISTER_VSYNC_2_4_CALLBACK
+	// Also get the period of every VSYNC, which varies with the active
+	// display config
+	hwc2_compat_device_register_vsync_2_4_callback(hwc2->hwc2_device,
+		&procs->listener, hwcomposer2_vsync_2_4_callback,
+		composer_sequence_id++);
+#endif
+
 	wlr_log(WLR_DEBUG, "hwcomposer2: register_callbaks: callbacks registered");
 }
 
 const struct hwcomposer_impl hwcomposer_hwc2 = {
 	.register_callbacks = hwcomposer2_register_callbacks,
 	.present = hwcomposer2_present,
+	.test_scanout = hwcomposer2_test_scanout,
+	.present_scanout = hwcomposer2_present_scanout,
+	.set_layers = hwcomposer2_set_layers,
+#if WLR_HAS_HWC2_COMPAT_LAYER_SET_SURFACE_DAMAGE
+	.set_damage = hwcomposer2_set_damage,
+#endif
+#if HWC2_HAS_DISPLAY_CONFIGS
+	.add_modes = hwcomposer2_add_modes,
+	.set_mode = hwcomposer2_set_mode,
+#endif
 	.vsync_control = hwcomposer2_vsync_control,
 	.set_power_mode = hwcomposer2_set_power_mode,
 	.add_output = hwcomposer2_add_output,
@@ -6,6 +6,7 @@
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <assert.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 
@@ -13,9 +14,11 @@
 #include <sys/cdefs.h> // for __BEGIN_DECLS/__END_DECLS found in sync.h
 #include <sync/sync.h>
 #include <hybris/hwcomposerwindow/hwcomposer.h>
+#include <system/window.h>
 
 #include <wlr/interfaces/wlr_output.h>
 #include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/util/region.h>
 #include <wlr/util/log.h>
 #include "backend/hwcomposer.h"
@@ -25,33 +28,80 @@
 #include <sys/epoll.h>
 #include <sys/timerfd.h>
 
+static int64_t get_current_time_nsec(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec * 1000000000LL) + now.tv_nsec;
+}
+
+/**
+ * Time to wake up before the targeted vsync.
+ */
+static int64_t frame_lead_time(struct wlr_hwcomposer_output *output) {
+	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
+	if (hwc_backend->idle_time_fixed) {
+		return hwc_backend->idle_time;
+	}
+
+	// Cover most frames, not only the average one
+	return output->render_time_avg + 2 * output->render_time_dev +
+		hwc_backend->render_margin;
+}
+
+static void update_render_time(struct wlr_hwcomposer_output *output) {
+	if (output->frame_start == 0) {
+		return;
+	}
+
+	int64_t now = get_current_time_nsec();
+	int64_t render_time = now - output->frame_start;
+	output->frame_start = 0;
+
+	if (now > output->frame_target_vsync) {
+		output->missed_deadlines++;
+		wlr_log(WLR_DEBUG, "Output %s missed its deadline by %" PRId64 " us "
+			"(%zu missed)", output->wlr_output.name,
+			(now - output->frame_target_vsync) / 1000,
+			output->missed_deadlines);
+	}
+
+	// Exponentially weighted moving average and mean deviation, as used
+	// to estimate round-trip times
+	int64_t error = render_time - output->render_time_avg;
+	output->render_time_avg += error / 8;
+	output->render_time_dev += (llabs(error) - output->render_time_dev) / 4;
+}
+
 static void schedule_frame(struct wlr_hwcomposer_output *output) {
 	int64_t time, display_refresh, next_vsync, scheduled_next;
-	struct timespec now, frame_tspec;
-
-	clock_gettime(CLOCK_MONOTONIC, &now);
+	struct timespec frame_tspec;
 
-	time = (now.tv_sec * 1000000000LL) +  now.tv_nsec;
-	display_refresh = MIN(output->hwc_refresh, output->hwc_backend->hwc_device_refresh);
-	next_vsync = output->hwc_backend->hwc_vsync_last_timestamp + display_refresh;
+	time = get_current_time_nsec();
+	int64_t vsync_period = atomic_load(&output->hwc_vsync_period);
+	display_refresh = vsync_period > 0 ? vsync_period : output->hwc_refresh;
+	next_vsync = atomic_load(&output->hwc_vsync_last_timestamp) + display_refresh;
 
 	// We need to schedule the frame render so that it can be hopefully
 	// be swapped before the next vsync.
 	//
-	// If the delta of the current time and the predicted next vsync
-	// is too close, we won't make it, so defer the render on the next
-	// cycle.
+	// Target the first vsync leaving enough time to render the frame, and
+	// wake up just in time for it, so that the frame is as fresh as
+	// possible.
 	//
 	// If the should_destroy flag is set, schedule the timer a bit farther,
 	// we don't care about syncronization anymore anyway.
 	if (output->should_destroy) {
 		scheduled_next = next_vsync + (display_refresh * 3);
-	} else if ((next_vsync - time) <= output->hwc_backend->idle_time) {
-		// Too close! Sad
-		scheduled_next = next_vsync + display_refresh - output->hwc_backend->idle_time;
 	} else {
-		// We can go ahead
-		scheduled_next = next_vsync - output->hwc_backend->idle_time;
+		int64_t lead = frame_lead_time(output);
+		int64_t target_vsync = next_vsync;
+		if (target_vsync - lead < time) {
+			int64_t cycles = (time + lead - target_vsync + display_refresh - 1) /
+				display_refresh;
+			target_vsync += cycles * display_refresh;
+		}
+		output->frame_target_vsync = target_vsync;
+		scheduled_next = target_vsync - lead;
 	}
 
 	timespec_from_nsec(&frame_tspec, scheduled_next);
@@ -90,6 +140,10 @@ static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 	}
 	wlr_log(WLR_DEBUG, "set_custom_mode: surface created");
 
+	// The damage region belonged to the previous surface
+	output->egl_damage_set = false;
+	pixman_region32_clear(&output->egl_damage);
+
 	output->frame_delay = 1000000 / refresh;
 
 	wlr_output_update_custom_mode(&output->wlr_output, width, height, refresh);
@@ -98,11 +152,169 @@ static bool output_set_custom_mode(struct wlr_output *wlr_output, int32_t width,
 	return true;
 }
 
+static bool output_set_mode(struct wlr_output *wlr_output,
+		struct wlr_output_mode *wlr_mode) {
+	struct wlr_hwcomposer_output *output =
+		(struct wlr_hwcomposer_output *)wlr_output;
+	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
+	struct wlr_hwcomposer_mode *mode = (struct wlr_hwcomposer_mode *)wlr_mode;
+
+	wlr_log(WLR_INFO, "output_set_mode width=%d height=%d refresh=%d",
+		wlr_mode->width, wlr_mode->height, wlr_mode->refresh);
+
+	if (hwc_backend->impl->set_mode == NULL ||
+			!hwc_backend->impl->set_mode(output, mode)) {
+		wlr_log(WLR_ERROR, "Failed to switch to display config %" PRIu32,
+			mode->hwc_config_id);
+		return false;
+	}
+
+	// Every mode shares the resolution of the native window, there is no
+	// need to recreate the EGL surface
+	output->hwc_refresh = 1000000000000LL / wlr_mode->refresh;
+	// Reported again with the next VSYNC
+	atomic_store(&output->hwc_vsync_period, 0);
+	output->frame_delay = 1000000 / wlr_mode->refresh;
+
+	wlr_output_update_mode(wlr_output, wlr_mode);
+	return true;
+}
+
+static struct ANativeWindowBuffer *output_import_scanout_buffer(
+		struct wlr_hwcomposer_output *output) {
+	struct wlr_output *wlr_output = &output->wlr_output;
+	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
+
+	if (hwc_backend->import_buffer == NULL ||
+			hwc_backend->impl->test_scanout == NULL ||
+			hwc_backend->impl->present_scanout == NULL) {
+		return NULL;
+	}
+
+	// The layer isn't transformed, the client buffer must match the
+	// display as is
+	enum wl_output_transform transform = wlr_output->transform;
+	if (wlr_output->pending.committed & WLR_OUTPUT_STATE_TRANSFORM) {
+		transform = wlr_output->pending.transform;
+	}
+	if (transform != WL_OUTPUT_TRANSFORM_NORMAL) {
+		return NULL;
+	}
+
+	return hwc_backend->import_buffer(wlr_output->pending.buffer,
+		hwc_backend->import_buffer_data);
+}
+
+static void output_set_scanout_buffer(struct wlr_hwcomposer_output *output,
+		struct wlr_buffer *buffer) {
+	// The commit before the previous one has been presented, its buffer is
+	// not being scanned out anymore
+	if (output->scanout_prev_buffer != NULL) {
+		wlr_buffer_unlock(output->scanout_prev_buffer);
+	}
+	output->scanout_prev_buffer = output->scanout_buffer;
+	output->scanout_buffer = buffer != NULL ? wlr_buffer_lock(buffer) : NULL;
+}
+
+static void buffer_array_release(struct wl_array *buffers) {
+	struct wlr_buffer **buffer_ptr;
+	wl_array_for_each(buffer_ptr, buffers) {
+		wlr_buffer_unlock(*buffer_ptr);
+	}
+	wl_array_release(buffers);
+	wl_array_init(buffers);
+}
+
+static bool buffer_array_add(struct wl_array *buffers,
+		struct wlr_buffer *buffer) {
+	struct wlr_buffer **buffer_ptr =
+		wl_array_add(buffers, sizeof(struct wlr_buffer *));
+	if (buffer_ptr == NULL) {
+		return false;
+	}
+	*buffer_ptr = wlr_buffer_lock(buffer);
+	return true;
+}
+
+static void output_rotate_layer_buffers(struct wlr_hwcomposer_output *output) {
+	// Same as output_set_scanout_buffer, for the layers' buffers
+	buffer_array_release(&output->layer_buffers_prev);
+	output->layer_buffers_prev = output->layer_buffers;
+	wl_array_init(&output->layer_buffers);
+
+	struct wlr_buffer **buffer_ptr;
+	wl_array_for_each(buffer_ptr, &output->layer_buffers_pending) {
+		buffer_array_add(&output->layer_buffers, *buffer_ptr);
+	}
+}
+
+bool wlr_hwcomposer_output_set_layers(struct wlr_output *wlr_output,
+		struct wlr_hwcomposer_layer *layers, size_t layers_len) {
+	assert(wlr_output_is_hwcomposer(wlr_output));
+	struct wlr_hwcomposer_output *output =
+		(struct wlr_hwcomposer_output *)wlr_output;
+	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
+
+	for (size_t i = 0; i < layers_len; i++) {
+		layers[i].composition = WLR_HWCOMPOSER_COMPOSITION_CLIENT;
+	}
+
+	buffer_array_release(&output->layer_buffers_pending);
+
+	if (hwc_backend->impl->set_layers == NULL) {
+		return false;
+	}
+
+	struct ANativeWindowBuffer **buffers = NULL;
+	int *acquire_fences = NULL;
+	if (layers_len > 0) {
+		buffers = calloc(layers_len, sizeof(struct ANativeWindowBuffer *));
+		acquire_fences = calloc(layers_len, sizeof(int));
+		if (buffers == NULL || acquire_fences == NULL) {
+			wlr_log(WLR_ERROR, "Allocation failed");
+			layers_len = 0;
+		}
+	}
+	for (size_t i = 0; i < layers_len; i++) {
+		acquire_fences[i] = -1;
+		if (hwc_backend->import_buffer != NULL && layers[i].buffer != NULL) {
+			buffers[i] = hwc_backend->import_buffer(layers[i].buffer,
+				hwc_backend->import_buffer_data);
+		}
+		if (buffers[i] != NULL) {
+			acquire_fences[i] =
+				hwcomposer_buffer_get_acquire_fence(layers[i].buffer);
+		}
+	}
+
+	bool ok = hwc_backend->impl->set_layers(output, layers, buffers,
+		acquire_fences, layers_len);
+	free(buffers);
+	free(acquire_fences);
+
+	// Keep the buffers alive as long as hwcomposer may read them
+	for (size_t i = 0; i < layers_len; i++) {
+		if (layers[i].composition == WLR_HWCOMPOSER_COMPOSITION_DEVICE) {
+			buffer_array_add(&output->layer_buffers_pending, layers[i].buffer);
+		}
+	}
+
+	return ok;
+}
+
 static bool output_test(struct wlr_output *wlr_output) {
+	struct wlr_hwcomposer_output *output =
+		(struct wlr_hwcomposer_output *)wlr_output;
+
 	if ((wlr_output->pending.committed & WLR_OUTPUT_STATE_BUFFER) &&
-		(wlr_output->pending.buffer_type & WLR_OUTPUT_STATE_BUFFER_SCANOUT)) {
-		/* Direct scan-out not supported yet */
-		return false;
+			wlr_output->pending.buffer_type == WLR_OUTPUT_STATE_BUFFER_SCANOUT) {
+		// Refuse the buffer if hwcomposer would need client composition to
+		// present it, so that the compositor renders with GLES instead. The
+		// test validates the display but leaves the layers as they were.
+		struct ANativeWindowBuffer *buffer =
+			output_import_scanout_buffer(output);
+		return buffer != NULL &&
+			output->hwc_backend->impl->test_scanout(output, buffer);
 	}
 
 	return true;
@@ -114,6 +326,7 @@ static bool output_commit(struct wlr_output *wlr_output) {
 	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
 
 	bool should_schedule_frame = false;
+	uint32_t present_flags = 0;
 
 	if (output->should_destroy) {
 		return false;
@@ -139,7 +352,11 @@ static bool output_commit(struct wlr_output *wlr_output) {
 	}
 
 	if (wlr_output->pending.committed & WLR_OUTPUT_STATE_MODE) {
-		if (!output_set_custom_mode(wlr_output,
+		if (wlr_output->pending.mode_type == WLR_OUTPUT_STATE_MODE_FIXED) {
+			if (!output_set_mode(wlr_output, wlr_output->pending.mode)) {
+				return false;
+			}
+		} else if (!output_set_custom_mode(wlr_output,
 				wlr_output->pending.custom_mode.width,
 				wlr_output->pending.custom_mode.height,
 				wlr_output->pending.custom_mode.refresh,
@@ -157,14 +374,37 @@ static bool output_commit(struct wlr_output *wlr_output) {
 
 		switch (wlr_output->pending.buffer_type) {
 		case WLR_OUTPUT_STATE_BUFFER_RENDER:
+			// Only the damage region set for partial update has been
+			// repainted, which may be larger than the committed damage
+			if (hwc_backend->impl->set_damage) {
+				hwc_backend->impl->set_damage(output, output->egl_damage_set ?
+					&output->egl_damage : damage);
+			}
+
 			if (!wlr_egl_swap_buffers(&hwc_backend->egl,
 					output->egl_surface, damage)) {
 				return false;
 			}
+			output->egl_damage_set = false;
+			pixman_region32_clear(&output->egl_damage);
+			output_set_scanout_buffer(output, NULL);
 			should_schedule_frame = true;
 			break;
-		case WLR_OUTPUT_STATE_BUFFER_SCANOUT:
-			wlr_log(WLR_ERROR, "WLR_OUTPUT_STATE_BUFFER_SCANOUT not implemented");
+		case WLR_OUTPUT_STATE_BUFFER_SCANOUT:;
+			struct ANativeWindowBuffer *buffer =
+				output_import_scanout_buffer(output);
+			if (buffer != NULL && hwc_backend->impl->set_damage) {
+				hwc_backend->impl->set_damage(output, damage);
+			}
+			if (buffer == NULL ||
+					!hwc_backend->impl->present_scanout(output, buffer,
+						hwcomposer_buffer_get_acquire_fence(
+							wlr_output->pending.buffer))) {
+				return false;
+			}
+			output_set_scanout_buffer(output, wlr_output->pending.buffer);
+			present_flags |= WLR_OUTPUT_PRESENT_ZERO_COPY;
+			should_schedule_frame = true;
 			break;
 		}
 	}
@@ -172,17 +412,9 @@ static bool output_commit(struct wlr_output *wlr_output) {
 	wlr_egl_unset_current(&hwc_backend->egl);
 
 	if (should_schedule_frame) {
-		// FIXME: wlroots submits a presentation event with commit_seq =
-		//  output_commit_seq + 1. For some unknown reason, we aren't
-		// off-by-one and the output commit sequence won't match the feedback's,
-		// thus presentation feedback will not be reported to the client.
-		// Also we should check why there appears a "ghost" presentation
-		// event just after the good one.
-		struct wlr_output_event_present present_event = {
-			.output = &output->wlr_output,
-			.commit_seq = output->wlr_output.commit_seq,
-		};
-		wlr_output_send_present(&output->wlr_output, &present_event);
+		update_render_time(output);
+		output_rotate_layer_buffers(output);
+		hwcomposer_output_queue_present(output, present_flags);
 		schedule_frame(output);
 	}
 
@@ -192,13 +424,27 @@ static bool output_commit(struct wlr_output *wlr_output) {
 static bool output_attach_render(struct wlr_output *wlr_output, int *buffer_age) {
 	struct wlr_hwcomposer_output *output =
 		(struct wlr_hwcomposer_output *)wlr_output;
-	return wlr_egl_make_current(&output->hwc_backend->egl, output->egl_surface,
-		buffer_age);
+	if (!wlr_egl_make_current(&output->hwc_backend->egl, output->egl_surface,
+			buffer_age)) {
+		return false;
+	}
+
+	// The back buffer can't be older than the number of buffers the native
+	// window cycles through, a larger age can't be trusted
+	if (buffer_age != NULL &&
+			*buffer_age > (int)output->window_buffers_len) {
+		wlr_log(WLR_DEBUG, "Ignoring buffer age %d of output %s", *buffer_age,
+			wlr_output->name);
+		*buffer_age = 0;
+	}
+
+	return true;
 }
 
 static bool output_handle_damage(struct wlr_output *wlr_output, pixman_region32_t *damage) {
 	struct wlr_hwcomposer_output *output =
 		(struct wlr_hwcomposer_output *)wlr_output;
+	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
 
 	if (damage == NULL) {
 		return true;
@@ -215,26 +461,48 @@ static bool output_handle_damage(struct wlr_output *wlr_output, pixman_region32_
 	int width, height;
 	wlr_output_transformed_resolution(wlr_output, &width, &height);
 
-	pixman_region32_t frame_damage;
-	pixman_region32_init(&frame_damage);
+	if (output->egl_damage_set) {
+		/*
+		 * The damage region can only be set once per back buffer, and the
+		 * last frame has been rolled back after setting it. Everything
+		 * inside that region has to be repainted, and everything outside
+		 * of it is preserved.
+		 */
+		pixman_region32_t set_damage;
+		pixman_region32_init(&set_damage);
+		wlr_region_transform(&set_damage, &output->egl_damage,
+			wlr_output->transform, wlr_output->width, wlr_output->height);
+
+		pixman_region32_t outside;
+		pixman_region32_init(&outside);
+		pixman_region32_subtract(&outside, damage, &set_damage);
+		if (pixman_region32_not_empty(&outside)) {
+			wlr_log(WLR_DEBUG, "Damage of output %s exceeds the region set "
+				"for partial update", wlr_output->name);
+		}
+		pixman_region32_fini(&outside);
+
+		pixman_region32_union(damage, damage, &set_damage);
+		pixman_region32_fini(&set_damage);
+		return true;
+	}
+
+	// Without damage, nothing is going to be rendered and the frame will
+	// most likely be rolled back. If it isn't, leaving the damage region
+	// unset keeps the whole buffer valid.
+	if (!pixman_region32_not_empty(damage)) {
+		return true;
+	}
 
-	wlr_region_transform(&frame_damage, damage,
+	wlr_region_transform(&output->egl_damage, damage,
 		wlr_output_transform_invert(wlr_output->transform), width, height);
 
-	if (wlr_output->needs_frame) {
-		/*
-		 * By checking for needs_frame, we're predicting the compositor's
-		 * behaviour, and it's horribly wrong.
-		 *
-		 * Unfortunately, the alternative would be to damage the whole
-		 * region when rollbacks happen.
-		 *
-		 * This will probably also break the "damage-tracking" debug
-		 * phoc feature.
-		*/
-		return wlr_egl_set_damage_region(&output->hwc_backend->egl,
-			output->egl_surface, &frame_damage);
+	if (!wlr_egl_set_damage_region(&hwc_backend->egl, output->egl_surface,
+			&output->egl_damage)) {
+		pixman_region32_clear(&output->egl_damage);
+		return false;
 	}
+	output->egl_damage_set = hwc_backend->egl.exts.partial_update_ext;
 
 	return true;
 }
@@ -257,6 +525,26 @@ static void output_destroy(struct wlr_output *wlr_output) {
 
 	wl_list_remove(&output->link);
 
+	// The backend is responsible for freeing the modes
+	struct wlr_hwcomposer_mode *mode, *mode_tmp;
+	wl_list_for_each_safe(mode, mode_tmp, &wlr_output->modes, wlr_mode.link) {
+		wl_list_remove(&mode->wlr_mode.link);
+		free(mode);
+	}
+
+	pixman_region32_fini(&output->egl_damage);
+
+	if (output->scanout_buffer) {
+		wlr_buffer_unlock(output->scanout_buffer);
+	}
+	if (output->scanout_prev_buffer) {
+		wlr_buffer_unlock(output->scanout_prev_buffer);
+	}
+	buffer_array_release(&output->layer_buffers_pending);
+	buffer_array_release(&output->layer_buffers);
+	buffer_array_release(&output->layer_buffers_prev);
+	hwcomposer_output_finish_presents(output);
+
 	if (output->vsync_timer) {
 		wl_event_source_remove(output->vsync_timer);
 	}
@@ -272,6 +560,47 @@ static void output_rollback_render(struct wlr_output *wlr_output) {
 	wlr_egl_unset_current(&output->hwc_backend->egl);
 }
 
+static size_t output_get_swapchain_len(struct wlr_output *wlr_output) {
+	struct wlr_hwcomposer_output *output =
+		(struct wlr_hwcomposer_output *)wlr_output;
+	return output->swapchain_len;
+}
+
+/**
+ * The number of buffers of a native window can't be queried, and the
+ * default of HWCNativeWindow differs between libhybris versions. Changing it
+ * could lower it below what the device needs, so it is only estimated.
+ */
+static size_t estimate_swapchain_len(struct ANativeWindow *window) {
+	int min_undequeued = 1;
+	if (window->query(window, NATIVE_WINDOW_MIN_UNDEQUEUED_BUFFERS,
+			&min_undequeued) != 0 || min_undequeued < 1) {
+		min_undequeued = 1;
+	}
+
+	// One buffer being rendered to and one queued, on top of those the
+	// consumer keeps
+	return min_undequeued + 2;
+}
+
+static void output_present(void *user_data, struct ANativeWindow *window,
+		struct ANativeWindowBuffer *buffer) {
+	struct wlr_hwcomposer_output *output = user_data;
+
+	bool found = false;
+	for (size_t i = 0; i < output->window_buffers_len; i++) {
+		if (output->window_buffers[i] == buffer) {
+			found = true;
+			break;
+		}
+	}
+	if (!found && output->window_buffers_len < HWCOMPOSER_MAX_WINDOW_BUFFERS) {
+		output->window_buffers[output->window_buffers_len++] = buffer;
+	}
+
+	output->hwc_backend->impl->present(output, window, buffer);
+}
+
 static const struct wlr_output_impl output_impl = {
 	.destroy = output_destroy,
 	.attach_render = output_attach_render,
@@ -279,6 +608,7 @@ static const struct wlr_output_impl output_impl = {
 	.commit = output_commit,
 	.rollback_render = output_rollback_render,
 	.test = output_test,
+	.get_swapchain_len = output_get_swapchain_len,
 };
 
 bool wlr_output_is_hwcomposer(struct wlr_output *wlr_output) {
@@ -290,6 +620,7 @@ static int signal_frame(int fd, uint32_t mask, void *data) {
 
 	uint64_t res;
 	if (read(fd, &res, sizeof(res)) > 0 && !output->should_destroy) {
+		output->frame_start = get_current_time_nsec();
 		wlr_output_send_frame(&output->wlr_output);
 	} else if (output->should_destroy) {
 		wlr_output_destroy(&output->wlr_output);
@@ -301,20 +632,19 @@ static int signal_frame(int fd, uint32_t mask, void *data) {
 static int on_vsync_timer_elapsed(void *data) {
 	struct wlr_hwcomposer_output *output = data;
 	struct wlr_hwcomposer_backend *hwc_backend = output->hwc_backend;
-	static int vsync_enable_tries = 0;
 	bool vsync_enabled;
 
 	// Ensure vsync gets enabled
 	vsync_enabled = hwc_backend->impl->vsync_control(output, true);
 
-	if (vsync_enabled && vsync_enable_tries < 5) {
+	if (vsync_enabled && output->vsync_enable_tries < 5) {
 		// Try again
 		if (wl_event_source_timer_update(output->vsync_timer,
 				output->frame_delay) == 0) {
-			vsync_enable_tries++;
+			output->vsync_enable_tries++;
 		}
 	} else if (vsync_enabled) {
-		vsync_enable_tries = 0;
+		output->vsync_enable_tries = 0;
 		schedule_frame(output);
 	}
 
@@ -349,6 +679,22 @@ struct wlr_output *wlr_hwcomposer_add_output(struct wlr_backend *wlr_backend,
 
 	wl_list_insert(&hwc_backend->outputs, &output->link);
 
+	wl_array_init(&output->layer_buffers_pending);
+	wl_array_init(&output->layer_buffers);
+	wl_array_init(&output->layer_buffers_prev);
+
+	output->present_fence_fd = -1;
+	wl_list_init(&output->presents);
+
+	output->render_time_avg = hwc_backend->idle_time;
+
+	output->egl_damage_set = false;
+	pixman_region32_init(&output->egl_damage);
+
+	// Until the first VSYNC of the display
+	output->hwc_vsync_enabled = false;
+	atomic_store(&output->hwc_vsync_last_timestamp, get_current_time_nsec());
+
 	output->should_destroy = false;
 
 	output->hwc_display_id = display;
@@ -356,7 +702,8 @@ struct wlr_output *wlr_hwcomposer_add_output(struct wlr_backend *wlr_backend,
 
 	output->egl_window = HWCNativeWindowCreate(
 		output->hwc_width, output->hwc_height,
-		HAL_PIXEL_FORMAT_RGBA_8888, hwc_backend->impl->present, output);
+		HAL_PIXEL_FORMAT_RGBA_8888, output_present, output);
+	output->swapchain_len = estimate_swapchain_len(output->egl_window);
 
 	output->egl_display = hwc_backend->egl.display;
 
@@ -369,6 +716,16 @@ struct wlr_output *wlr_hwcomposer_add_output(struct wlr_backend *wlr_backend,
 		goto error;
 	}
 
+	if (hwc_backend->impl->add_modes) {
+		hwc_backend->impl->add_modes(output);
+
+		// The preferred mode is the active display config
+		struct wlr_output_mode *mode = wlr_output_preferred_mode(wlr_output);
+		if (mode != NULL && mode->preferred) {
+			wlr_output_update_mode(wlr_output, mode);
+		}
+	}
+
 	if (wlr_egl_make_current(&hwc_backend->egl, output->egl_surface,
 			NULL)) {
 		wlr_renderer_begin(hwc_backend->renderer, wlr_output->width, wlr_output->height);
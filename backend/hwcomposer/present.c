@@ -0,0 +1,149 @@
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <linux/sync_file.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <wlr/interfaces/wlr_output.h>
+#include <wlr/util/log.h>
+#include "backend/hwcomposer.h"
+#include "util/time.h"
+
+/**
+ * Get the time a signaled sync file fence was signaled at, in the
+ * CLOCK_MONOTONIC domain.
+ */
+static bool fence_get_timestamp(int fence_fd, struct timespec *when) {
+	struct sync_fence_info fence_info = {0};
+	struct sync_file_info file_info = {
+		.num_fences = 1,
+		.sync_fence_info = (uint64_t)(uintptr_t)&fence_info,
+	};
+
+	if (ioctl(fence_fd, SYNC_IOC_FILE_INFO, &file_info) != 0 ||
+			file_info.status != 1 || fence_info.timestamp_ns == 0) {
+		return false;
+	}
+
+	timespec_from_nsec(when, fence_info.timestamp_ns);
+	return true;
+}
+
+static void present_destroy(struct wlr_hwcomposer_present *present) {
+	if (present->event != NULL) {
+		wl_event_source_remove(present->event);
+	}
+	if (present->fence_fd >= 0) {
+		close(present->fence_fd);
+	}
+	wl_list_remove(&present->link);
+	free(present);
+}
+
+static void present_send(struct wlr_hwcomposer_present *present) {
+	struct wlr_hwcomposer_output *output = present->output;
+
+	struct timespec when;
+	uint32_t flags = present->flags;
+	if (present->fence_fd >= 0 &&
+			fence_get_timestamp(present->fence_fd, &when)) {
+		flags |= WLR_OUTPUT_PRESENT_HW_CLOCK;
+	} else {
+		clock_gettime(CLOCK_MONOTONIC, &when);
+	}
+
+	// The display config's period is only nominal, prefer the one measured
+	// by hwcomposer when it's reported
+	int64_t vsync_period = atomic_load(&output->hwc_vsync_period);
+	int64_t refresh = vsync_period > 0 ? vsync_period : output->hwc_refresh;
+
+	struct wlr_output_event_present event = {
+		.output = &output->wlr_output,
+		.commit_seq = present->commit_seq,
+		.when = &when,
+		.refresh = refresh,
+		.flags = flags,
+	};
+
+	present_destroy(present);
+	wlr_output_send_present(&output->wlr_output, &event);
+}
+
+static int present_handle_fence(int fd, uint32_t mask, void *data) {
+	struct wlr_hwcomposer_present *present = data;
+
+	if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		wlr_log(WLR_ERROR, "Failed to wait for present fence");
+		present->flags &= ~WLR_OUTPUT_PRESENT_HW_COMPLETION;
+		close(present->fence_fd);
+		present->fence_fd = -1;
+	}
+
+	present_send(present);
+	return 0;
+}
+
+static void present_handle_idle(void *data) {
+	struct wlr_hwcomposer_present *present = data;
+	// Idle sources are removed once dispatched
+	present->event = NULL;
+	present_send(present);
+}
+
+void hwcomposer_output_queue_present(struct wlr_hwcomposer_output *output,
+		uint32_t flags) {
+	int fence_fd = output->present_fence_fd;
+	output->present_fence_fd = -1;
+
+	struct wlr_hwcomposer_present *present =
+		calloc(1, sizeof(struct wlr_hwcomposer_present));
+	if (present == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		if (fence_fd >= 0) {
+			close(fence_fd);
+		}
+		return;
+	}
+	present->output = output;
+	present->fence_fd = fence_fd;
+	// Called from the backend's commit, before wlr_output increments
+	// commit_seq
+	present->commit_seq = output->wlr_output.commit_seq + 1;
+	present->flags = flags | WLR_OUTPUT_PRESENT_VSYNC;
+	wl_list_insert(output->presents.prev, &present->link);
+
+	struct wl_event_loop *loop =
+		wl_display_get_event_loop(output->hwc_backend->display);
+	if (fence_fd >= 0) {
+		// The present fence signals when the frame starts being scanned out
+		present->flags |= WLR_OUTPUT_PRESENT_HW_COMPLETION;
+		present->event = wl_event_loop_add_fd(loop, fence_fd,
+			WL_EVENT_READABLE, present_handle_fence, present);
+	} else {
+		// Without fence, the frame is assumed to be presented right after
+		// the commit
+		present->event = wl_event_loop_add_idle(loop, present_handle_idle,
+			present);
+	}
+	if (present->event == NULL) {
+		wlr_log(WLR_ERROR, "Failed to wait for frame presentation");
+		present_destroy(present);
+	}
+}
+
+void hwcomposer_output_finish_presents(struct wlr_hwcomposer_output *output) {
+	struct wlr_hwcomposer_present *present, *tmp;
+	wl_list_for_each_safe(present, tmp, &output->presents, link) {
+		present_destroy(present);
+	}
+
+	if (output->present_fence_fd >= 0) {
+		close(output->present_fence_fd);
+		output->present_fence_fd = -1;
+	}
+}
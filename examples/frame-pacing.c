@@ -0,0 +1,259 @@
+#define _POSIX_C_SOURCE 200112L
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-server-core.h>
+#include <wlr/backend.h>
+#include <wlr/render/wlr_renderer.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/util/log.h>
+
+/*
+ * Renders a frame on every output's frame event and reports the frame pacing
+ * observed through present events: intervals between presents counted in
+ * refresh periods, missed refreshes, and latency from the frame event to the
+ * present. Stops after the requested number of presents on every output.
+ */
+
+// Present intervals are counted in refresh periods up to this bucket
+#define PACING_INTERVAL_BUCKETS 5
+// Frame events of the commits not presented yet, indexed by commit sequence
+#define PACING_PENDING_LEN 8
+
+struct sample_state {
+	struct wl_display *display;
+	struct wlr_backend *backend;
+	struct wl_listener new_output;
+	struct wl_list outputs; // sample_output::link
+	size_t max_presents;
+	float color[4];
+};
+
+struct pacing_stats {
+	size_t frames, presents;
+	size_t missed_refreshes;
+	size_t intervals[PACING_INTERVAL_BUCKETS];
+	int64_t latency_min, latency_max, latency_sum; // nsec
+	int64_t last_present; // nsec
+};
+
+struct sample_output {
+	struct sample_state *sample;
+	struct wlr_output *output;
+	struct wl_list link; // sample_state::outputs
+	struct wl_listener frame;
+	struct wl_listener present;
+	struct wl_listener destroy;
+
+	int64_t frame_times[PACING_PENDING_LEN]; // nsec
+	struct pacing_stats stats;
+};
+
+static int64_t timespec_to_nsec(const struct timespec *ts) {
+	return (int64_t)ts->tv_sec * 1000000000 + ts->tv_nsec;
+}
+
+static int64_t get_time_nsec(struct sample_state *sample) {
+	struct timespec now;
+	clock_gettime(wlr_backend_get_presentation_clock(sample->backend), &now);
+	return timespec_to_nsec(&now);
+}
+
+static void output_report(struct sample_output *sample_output) {
+	struct pacing_stats *stats = &sample_output->stats;
+
+	printf("%s: %zu frames, %zu presents, %zu missed refreshes\n",
+		sample_output->output->name, stats->frames, stats->presents,
+		stats->missed_refreshes);
+	if (stats->presents == 0) {
+		return;
+	}
+
+	printf("  intervals:");
+	for (size_t i = 0; i < PACING_INTERVAL_BUCKETS; i++) {
+		printf(" %zu%s:%zu", i + 1,
+			i == PACING_INTERVAL_BUCKETS - 1 ? "+" : "", stats->intervals[i]);
+	}
+	printf("\n");
+	printf("  latency: min %.2f ms, avg %.2f ms, max %.2f ms\n",
+		stats->latency_min / 1000000.0,
+		stats->latency_sum / (double)stats->presents / 1000000.0,
+		stats->latency_max / 1000000.0);
+}
+
+static void output_frame_notify(struct wl_listener *listener, void *data) {
+	struct sample_output *sample_output =
+		wl_container_of(listener, sample_output, frame);
+	struct sample_state *sample = sample_output->sample;
+	struct wlr_output *wlr_output = sample_output->output;
+
+	// Alternate between two colors so that every frame has content
+	uint32_t seq = wlr_output->commit_seq;
+	float color[4] = { sample->color[0], sample->color[1], sample->color[2],
+		sample->color[3] };
+	if (seq % 2) {
+		color[0] = 1.0f - color[0];
+	}
+
+	// Present events carry the sequence number of the commit once applied
+	sample_output->frame_times[(seq + 1) % PACING_PENDING_LEN] =
+		get_time_nsec(sample);
+
+	if (!wlr_output_attach_render(wlr_output, NULL)) {
+		return;
+	}
+
+	struct wlr_renderer *renderer =
+		wlr_backend_get_renderer(wlr_output->backend);
+	wlr_renderer_begin(renderer, wlr_output->width, wlr_output->height);
+	wlr_renderer_clear(renderer, color);
+	wlr_renderer_end(renderer);
+
+	if (wlr_output_commit(wlr_output)) {
+		sample_output->stats.frames++;
+	}
+}
+
+static bool sample_done(struct sample_state *sample) {
+	struct sample_output *sample_output;
+	wl_list_for_each(sample_output, &sample->outputs, link) {
+		if (sample_output->stats.presents < sample->max_presents) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void output_present_notify(struct wl_listener *listener, void *data) {
+	struct sample_output *sample_output =
+		wl_container_of(listener, sample_output, present);
+	struct wlr_output_event_present *event = data;
+	struct pacing_stats *stats = &sample_output->stats;
+
+	if (event->when == NULL) {
+		// The commit was discarded
+		return;
+	}
+
+	int64_t when = timespec_to_nsec(event->when);
+	int64_t frame_time =
+		sample_output->frame_times[event->commit_seq % PACING_PENDING_LEN];
+	int64_t latency = when - frame_time;
+
+	stats->presents++;
+	stats->latency_sum += latency;
+	if (latency < stats->latency_min) {
+		stats->latency_min = latency;
+	}
+	if (latency > stats->latency_max) {
+		stats->latency_max = latency;
+	}
+
+	if (stats->last_present != 0 && event->refresh > 0) {
+		int64_t refreshes = (when - stats->last_present + event->refresh / 2) /
+			event->refresh;
+		if (refreshes < 1) {
+			refreshes = 1;
+		}
+		stats->missed_refreshes += refreshes - 1;
+		size_t bucket = refreshes - 1;
+		if (bucket >= PACING_INTERVAL_BUCKETS) {
+			bucket = PACING_INTERVAL_BUCKETS - 1;
+		}
+		stats->intervals[bucket]++;
+	}
+	stats->last_present = when;
+
+	if (sample_done(sample_output->sample)) {
+		wl_display_terminate(sample_output->sample->display);
+	}
+}
+
+static void output_remove_notify(struct wl_listener *listener, void *data) {
+	struct sample_output *sample_output =
+		wl_container_of(listener, sample_output, destroy);
+	output_report(sample_output);
+	wl_list_remove(&sample_output->link);
+	wl_list_remove(&sample_output->frame.link);
+	wl_list_remove(&sample_output->present.link);
+	wl_list_remove(&sample_output->destroy.link);
+	free(sample_output);
+}
+
+static void new_output_notify(struct wl_listener *listener, void *data) {
+	struct wlr_output *output = data;
+	struct sample_state *sample =
+		wl_container_of(listener, sample, new_output);
+	struct sample_output *sample_output =
+		calloc(1, sizeof(struct sample_output));
+	if (sample_output == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return;
+	}
+
+	struct wlr_output_mode *mode = wlr_output_preferred_mode(output);
+	if (mode != NULL) {
+		wlr_output_set_mode(output, mode);
+	}
+	sample_output->output = output;
+	sample_output->sample = sample;
+	sample_output->stats.latency_min = INT64_MAX;
+	wl_list_insert(&sample->outputs, &sample_output->link);
+	wl_signal_add(&output->events.frame, &sample_output->frame);
+	sample_output->frame.notify = output_frame_notify;
+	wl_signal_add(&output->events.present, &sample_output->present);
+	sample_output->present.notify = output_present_notify;
+	wl_signal_add(&output->events.destroy, &sample_output->destroy);
+	sample_output->destroy.notify = output_remove_notify;
+
+	wlr_output_commit(sample_output->output);
+}
+
+int main(int argc, char *argv[]) {
+	wlr_log_init(WLR_INFO, NULL);
+
+	size_t max_presents = 600;
+	int c;
+	while ((c = getopt(argc, argv, "n:")) != -1) {
+		switch (c) {
+		case 'n':
+			max_presents = strtoul(optarg, NULL, 10);
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n presents]\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	struct wl_display *display = wl_display_create();
+	struct sample_state state = {
+		.display = display,
+		.max_presents = max_presents,
+		.color = { 0.25, 0.25, 0.25, 1.0 },
+	};
+	wl_list_init(&state.outputs);
+
+	struct wlr_backend *backend = wlr_backend_autocreate(display, NULL);
+	if (!backend) {
+		exit(1);
+	}
+	state.backend = backend;
+	wl_signal_add(&backend->events.new_output, &state.new_output);
+	state.new_output.notify = new_output_notify;
+
+	if (!wlr_backend_start(backend)) {
+		wlr_log(WLR_ERROR, "Failed to start backend");
+		wlr_backend_destroy(backend);
+		exit(1);
+	}
+	wl_display_run(display);
+
+	// Outputs report their statistics when destroyed
+	wlr_backend_destroy(backend);
+	wl_display_destroy(display);
+}
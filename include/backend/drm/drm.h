@@ -13,6 +13,7 @@
 #include <wlr/backend/session.h>
 #include <wlr/render/drm_format_set.h>
 #include <wlr/render/egl.h>
+#include <wlr/util/box.h>
 #include <xf86drmMode.h>
 #include "iface.h"
 #include "properties.h"
@@ -39,6 +40,9 @@ struct wlr_drm_plane {
 	bool cursor_enabled;
 	int32_t cursor_hotspot_x, cursor_hotspot_y;
 
+	// Only used by overlays, destination of the pending buffer on the CRTC
+	struct wlr_box overlay_dst;
+
 	union wlr_drm_plane_props props;
 };
 
@@ -60,15 +64,23 @@ struct wlr_drm_crtc {
 	// Legacy only
 	drmModeCrtc *legacy_crtc;
 
+	// Connector using this CRTC, if any
+	struct wlr_drm_connector *conn;
+
 	struct wlr_drm_plane *primary;
 	struct wlr_drm_plane *cursor;
 
+	// Sorted from bottom to top, atomic modesetting only
+	size_t num_overlays;
+	struct wlr_drm_plane **overlays;
 	/*
-	 * We don't support overlay planes yet, but we keep track of them to
-	 * give to DRM lease clients.
+	 * The pending framebuffers of the overlay planes are the ones proposed
+	 * with wlr_drm_connector_test_overlays for the next page-flip. This is
+	 * set while committing or testing that frame, when overlays without a
+	 * pending framebuffer get disabled. Otherwise, commits leave the
+	 * overlays as they are.
 	 */
-	size_t num_overlays;
-	uint32_t *overlays;
+	bool overlays_pending;
 
 	union wlr_drm_crtc_props props;
 };
@@ -98,6 +110,13 @@ struct wlr_drm_backend {
 
 	struct wlr_drm_renderer renderer;
 	struct wlr_session *session;
+
+	struct wlr_drm_prop_cache prop_cache;
+
+	// Asynchronous connector scan in progress, if any
+	struct wlr_drm_scan *scan;
+	// Set when connectors changed again during the scan
+	bool scan_again;
 };
 
 enum wlr_drm_connector_state {
@@ -140,6 +159,10 @@ struct wlr_drm_connector {
 	 * they're sent.
 	 */
 	bool pageflip_pending;
+
+	// Signalled when the last committed frame starts being scanned out, -1
+	// if unavailable. Atomic modesetting only.
+	int out_fence_fd;
 };
 
 struct wlr_drm_backend *get_drm_backend_from_backend(
@@ -149,6 +172,8 @@ bool init_drm_resources(struct wlr_drm_backend *drm);
 void finish_drm_resources(struct wlr_drm_backend *drm);
 void restore_drm_outputs(struct wlr_drm_backend *drm);
 void scan_drm_connectors(struct wlr_drm_backend *state);
+void scan_drm_connectors_async(struct wlr_drm_backend *drm);
+void finish_drm_scan(struct wlr_drm_backend *drm);
 int handle_drm_event(int fd, uint32_t mask, void *data);
 bool drm_connector_set_mode(struct wlr_drm_connector *conn,
 	struct wlr_output_mode *mode);
@@ -38,8 +38,9 @@ union wlr_drm_crtc_props {
 
 		uint32_t active;
 		uint32_t mode_id;
+		uint32_t out_fence_ptr;
 	};
-	uint32_t props[6];
+	uint32_t props[8];
 };
 
 union wlr_drm_plane_props {
@@ -60,14 +61,31 @@ union wlr_drm_plane_props {
 		uint32_t crtc_h;
 		uint32_t fb_id;
 		uint32_t crtc_id;
+		uint32_t in_fence_fd;
 	};
-	uint32_t props[13];
+	uint32_t props[14];
 };
 
-bool get_drm_connector_props(int fd, uint32_t id,
-	union wlr_drm_connector_props *out);
-bool get_drm_crtc_props(int fd, uint32_t id, union wlr_drm_crtc_props *out);
-bool get_drm_plane_props(int fd, uint32_t id, union wlr_drm_plane_props *out);
+struct wlr_drm_prop_name;
+
+/*
+ * Names of the properties seen so far, sorted by id. Property ids are global
+ * to a DRM device and never change, so this avoids querying them again on
+ * hotplug.
+ */
+struct wlr_drm_prop_cache {
+	size_t len, cap;
+	struct wlr_drm_prop_name *names;
+};
+
+void finish_drm_prop_cache(struct wlr_drm_prop_cache *cache);
+
+bool get_drm_connector_props(int fd, struct wlr_drm_prop_cache *cache,
+	uint32_t id, union wlr_drm_connector_props *out);
+bool get_drm_crtc_props(int fd, struct wlr_drm_prop_cache *cache,
+	uint32_t id, union wlr_drm_crtc_props *out);
+bool get_drm_plane_props(int fd, struct wlr_drm_prop_cache *cache,
+	uint32_t id, union wlr_drm_plane_props *out);
 
 bool get_drm_prop(int fd, uint32_t obj, uint32_t prop, uint64_t *ret);
 void *get_drm_prop_blob(int fd, uint32_t obj, uint32_t prop, size_t *ret_len);
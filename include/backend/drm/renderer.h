@@ -30,6 +30,10 @@ struct wlr_drm_surface {
 
 	struct gbm_surface *gbm;
 	EGLSurface egl;
+
+	// Multi-GPU only: set once buffers rendered by the parent GPU turned out
+	// not to be scanned out directly, and need to be copied to this surface
+	bool needs_copy;
 };
 
 enum wlr_drm_fb_type {
@@ -42,6 +46,7 @@ struct wlr_drm_fb {
 	enum wlr_drm_fb_type type;
 	struct gbm_bo *bo;
 
+	// mgpu_surf is NULL if mgpu_bo has been imported without any copy
 	struct wlr_drm_surface *mgpu_surf;
 	struct gbm_bo *mgpu_bo;
 
@@ -49,6 +54,10 @@ struct wlr_drm_fb {
 		struct wlr_drm_surface *surf;
 		struct wlr_buffer *wlr_buf;
 	};
+
+	// Signalled when rendering to the surface is done, -1 if unavailable.
+	// Only valid for WLR_DRM_FB_TYPE_SURFACE.
+	int in_fence_fd;
 };
 
 bool init_drm_renderer(struct wlr_drm_backend *drm,
@@ -18,8 +18,8 @@ struct wlr_headless_backend {
 	struct wl_list input_devices;
 	struct wl_listener display_destroy;
 	struct wl_listener renderer_destroy;
+	struct wlr_allocator *allocator;
 	bool started;
-	GLenum internal_format;
 };
 
 struct wlr_headless_output {
@@ -28,7 +28,8 @@ struct wlr_headless_output {
 	struct wlr_headless_backend *backend;
 	struct wl_list link;
 
-	GLuint fbo, rbo;
+	struct wlr_swapchain *swapchain;
+	struct wlr_buffer *back_buffer, *front_buffer;
 
 	struct wl_event_source *frame_timer;
 	int frame_delay; // ms
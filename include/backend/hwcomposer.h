@@ -1,6 +1,8 @@
 #ifndef BACKEND_HWCOMPOSER_H
 #define BACKEND_HWCOMPOSER_H
 
+#include <EGL/egl.h>
+#include <stdatomic.h>
 #include <wlr/backend/hwcomposer.h>
 #include <wlr/backend/interface.h>
 
@@ -12,6 +14,18 @@
 #endif
 
 #define HWCOMPOSER_DEFAULT_REFRESH (60 * 1000) // 60 Hz
+// Maximum number of native window buffers tracked to validate buffer ages
+#define HWCOMPOSER_MAX_WINDOW_BUFFERS 8
+
+// EGL_HYBRIS_WL_acquire_native_buffer, exposed by the libhybris EGL
+// implementation for the wl_buffers of its android_wlegl protocol
+#ifndef EGL_HYBRIS_WL_acquire_native_buffer
+#define EGL_HYBRIS_WL_acquire_native_buffer 1
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLHYBRISACQUIRENATIVEBUFFERWL)(
+	EGLDisplay dpy, struct wl_resource *wlBuffer, EGLClientBuffer *buffer);
+typedef EGLBoolean (EGLAPIENTRYP PFNEGLHYBRISRELEASENATIVEBUFFERWL)(
+	EGLDisplay dpy, EGLClientBuffer buffer);
+#endif
 
 struct hwcomposer_impl;
 
@@ -28,19 +42,45 @@ struct wlr_hwcomposer_backend {
 	bool started;
 
 	uint32_t hwc_version;
-	bool hwc_vsync_enabled;
 
+	// Time needed to render and swap a frame, used until outputs have
+	// measured their own. If set by the user, it is used as is.
 	int64_t idle_time; // nsec
+	bool idle_time_fixed;
+	// Safety margin added to the measured render time
+	int64_t render_margin; // nsec
+
+	// Resolves client buffers for direct scan-out, may be NULL
+	wlr_hwcomposer_import_buffer_func_t import_buffer;
+	void *import_buffer_data;
+
+	// Default import_buffer, only set if the EGL implementation supports
+	// EGL_HYBRIS_WL_acquire_native_buffer
+	PFNEGLHYBRISACQUIRENATIVEBUFFERWL egl_acquire_native_buffer;
+	PFNEGLHYBRISRELEASENATIVEBUFFERWL egl_release_native_buffer;
+	struct wl_list native_buffers; // wlr_hwcomposer_native_buffer::link
+};
 
-	// This is the refresh rate of the main display. Every display is driven
-	// by the VSYNC signal of the primary one, so this is going to be the
-	// maximum refresh rate supported.
-	int64_t hwc_device_refresh;
+/**
+ * A gralloc buffer acquired from a client buffer by the default importer,
+ * released along with the client buffer.
+ */
+struct wlr_hwcomposer_native_buffer {
+	struct wlr_hwcomposer_backend *hwc_backend;
+	struct wl_list link; // wlr_hwcomposer_backend::native_buffers
 
-	// Per the Android docs, every display is driven by the VSYNC signal
-	// of the internal one, so it makes sense to keep this into the backend.
-	int64_t hwc_vsync_last_timestamp;
-	// TODO: Also store 'vsyncPeriodNanos' if vsync2_4 is supported
+	struct wlr_buffer *buffer;
+	struct wl_resource *resource;
+	EGLClientBuffer native; // struct ANativeWindowBuffer *
+	struct wl_listener buffer_destroy;
+};
+
+/**
+ * A display config of the output, exposed as an output mode.
+ */
+struct wlr_hwcomposer_mode {
+	struct wlr_output_mode wlr_mode;
+	uint32_t hwc_config_id;
 };
 
 struct wlr_hwcomposer_output {
@@ -50,11 +90,24 @@ struct wlr_hwcomposer_output {
 	struct wl_list link;
 
 	struct ANativeWindow *egl_window;
+	// Estimation of the number of gralloc buffers the native window cycles
+	// through, used to size the damage history
+	size_t swapchain_len;
+	// Distinct buffers the native window has presented so far: its buffer
+	// count can't be queried, buffer ages are validated against these
+	struct ANativeWindowBuffer *window_buffers[HWCOMPOSER_MAX_WINDOW_BUFFERS];
+	size_t window_buffers_len;
 	void *egl_display;
 	void *egl_surface;
 
 	struct wlr_egl egl;
 
+	// Damage region set with EGL_KHR_partial_update for the back buffer,
+	// in buffer-local coordinates. It can't be changed until the buffer is
+	// swapped.
+	pixman_region32_t egl_damage;
+	bool egl_damage_set;
+
 	bool hwc_is_primary;
 	uint64_t hwc_display_id;
 	int hwc_left;
@@ -65,17 +118,86 @@ struct wlr_hwcomposer_output {
 	int hwc_phys_height;
 	int64_t hwc_refresh;
 
+	// External displays don't follow the VSYNC signal of the internal one,
+	// every output is paced by its own. The timestamp and period are
+	// written from the thread the hwcomposer callbacks are called from,
+	// hence the atomics: 64-bit accesses may tear on 32-bit ARM.
+	bool hwc_vsync_enabled;
+	atomic_int_fast64_t hwc_vsync_last_timestamp; // nsec
+	// Period of the last VSYNC, only reported since HWC 2.4: zero otherwise
+	atomic_int_fast64_t hwc_vsync_period; // nsec
+
 	struct wl_event_source *vsync_timer;
+	int vsync_enable_tries;
 	int frame_delay; // ms
+	// Frame scheduling: time the frame event was sent at, vsync the frame
+	// was scheduled for, and estimation of the render time, as an average
+	// and mean deviation of the recent frames
+	int64_t frame_start; // nsec, zero if no frame is being rendered
+	int64_t frame_target_vsync; // nsec
+	int64_t render_time_avg; // nsec
+	int64_t render_time_dev; // nsec
+	size_t missed_deadlines;
 	int vsync_timer_fd;
 	struct wl_event_source *vsync_event;
 
+	// Client buffers of the last two commits, if they were scanned out
+	// directly. A buffer can be released once the commit after it has been
+	// presented.
+	struct wlr_buffer *scanout_buffer;
+	struct wlr_buffer *scanout_prev_buffer;
+
+	// Client buffers presented on device layers, as wl_arrays of
+	// struct wlr_buffer *: set by the last wlr_hwcomposer_output_set_layers
+	// call, and used by the last two commits
+	struct wl_array layer_buffers_pending;
+	struct wl_array layer_buffers;
+	struct wl_array layer_buffers_prev;
+
+	// Present fence of the last frame handed to hwcomposer, -1 if none
+	int present_fence_fd;
+	struct wl_list presents; // wlr_hwcomposer_present::link
+
 	bool should_destroy;
 };
 
+/**
+ * A committed frame waiting to be presented.
+ */
+struct wlr_hwcomposer_present {
+	struct wlr_hwcomposer_output *output;
+	struct wl_list link; // wlr_hwcomposer_output::presents
+
+	uint32_t commit_seq;
+	uint32_t flags; // enum wlr_output_present_flag
+	int fence_fd;
+	struct wl_event_source *event;
+};
+
 struct hwcomposer_impl {
 	void (*register_callbacks)(struct wlr_hwcomposer_backend *hwc_backend);
 	void (*present)(void *user_data, struct ANativeWindow *window, struct ANativeWindowBuffer *buffer);
+	// Optional, check whether hwcomposer can present the buffer without
+	// client composition. This validates the display, the layer state is
+	// restored afterwards but the display must be validated again before
+	// the next present.
+	bool (*test_scanout)(struct wlr_hwcomposer_output *output, struct ANativeWindowBuffer *buffer);
+	// Optional, present the buffer without client composition. Takes
+	// ownership of acquire_fence, -1 if the buffer is complete.
+	bool (*present_scanout)(struct wlr_hwcomposer_output *output, struct ANativeWindowBuffer *buffer,
+		int acquire_fence);
+	// Optional, set the layers above the client target and update their
+	// composition. buffers[i] is NULL if layers[i] can't be imported. Takes
+	// ownership of the acquire_fences, -1 if the buffer is complete.
+	bool (*set_layers)(struct wlr_hwcomposer_output *output, struct wlr_hwcomposer_layer *layers,
+		struct ANativeWindowBuffer **buffers, int *acquire_fences, size_t layers_len);
+	// Optional, add the display configs of the output to its modes
+	void (*add_modes)(struct wlr_hwcomposer_output *output);
+	// Optional, switch the output to the display config of the mode
+	bool (*set_mode)(struct wlr_hwcomposer_output *output, struct wlr_hwcomposer_mode *mode);
+	// Optional, set the damage of the next buffer presented on the output,
+	// in buffer-local coordinates. NULL means the whole buffer.
+	void (*set_damage)(struct wlr_hwcomposer_output *output, pixman_region32_t *damage);
 	bool (*vsync_control)(struct wlr_hwcomposer_output *output, bool enable);
 	bool (*set_power_mode)(struct wlr_hwcomposer_output *output, bool enable);
 	struct wlr_hwcomposer_output *(*add_output)(struct wlr_hwcomposer_backend *hwc_backend, int display);
@@ -84,6 +206,23 @@ struct hwcomposer_impl {
 };
 
 void hwcomposer_init(struct wlr_hwcomposer_backend *hwc_backend);
+/**
+ * Set up the default buffer importer, if the EGL implementation supports it.
+ */
+void hwcomposer_init_import_buffer(struct wlr_hwcomposer_backend *hwc_backend);
+void hwcomposer_finish_import_buffer(struct wlr_hwcomposer_backend *hwc_backend);
+/**
+ * Returns a sync_file FD signalled once the GPU is done writing into the
+ * buffer, or -1 if the buffer can't provide one.
+ */
+int hwcomposer_buffer_get_acquire_fence(struct wlr_buffer *buffer);
+/**
+ * Send a present event for the frame being committed, once its present fence
+ * (output->present_fence_fd) signals.
+ */
+void hwcomposer_output_queue_present(struct wlr_hwcomposer_output *output,
+	uint32_t flags);
+void hwcomposer_output_finish_presents(struct wlr_hwcomposer_output *output);
 struct wlr_hwcomposer_backend *hwcomposer_api_init(hw_device_t *hwc_device);
 #ifdef HWC_DEVICE_API_VERSION_2_0
 struct wlr_hwcomposer_backend *hwcomposer2_api_init(hw_device_t *hwc_device);
@@ -0,0 +1,46 @@
+#ifndef RENDER_ALLOCATOR_H
+#define RENDER_ALLOCATOR_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+#include <wlr/render/drm_format_set.h>
+
+struct wlr_allocator;
+
+struct wlr_allocator_interface {
+	struct wlr_buffer *(*create_buffer)(struct wlr_allocator *alloc,
+		int width, int height, const struct wlr_drm_format *format);
+	void (*destroy)(struct wlr_allocator *alloc);
+};
+
+/**
+ * An allocator is responsible for allocating memory for pixel buffers.
+ */
+struct wlr_allocator {
+	const struct wlr_allocator_interface *impl;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+};
+
+/**
+ * Destroy the allocator. Buffers created by the allocator stay valid, but no
+ * new buffers can be created.
+ */
+void wlr_allocator_destroy(struct wlr_allocator *alloc);
+/**
+ * Allocate a new buffer. The format's modifiers are a hint: an empty list
+ * means the allocator picks an implicit layout.
+ *
+ * The returned buffer is referenced by the caller, who is responsible for
+ * calling wlr_buffer_drop once done.
+ */
+struct wlr_buffer *wlr_allocator_create_buffer(struct wlr_allocator *alloc,
+	int width, int height, const struct wlr_drm_format *format);
+
+// For wlr_allocator implementors
+void wlr_allocator_init(struct wlr_allocator *alloc,
+	const struct wlr_allocator_interface *impl);
+
+#endif
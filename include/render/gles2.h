@@ -12,7 +12,9 @@
 #include <wlr/render/interface.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/render/wlr_texture.h>
+#include <wlr/types/wlr_buffer.h>
 #include <wlr/util/log.h>
+#include "render/allocator.h"
 
 struct wlr_gles2_pixel_format {
 	enum wl_shm_format wl_format;
@@ -21,14 +23,22 @@ struct wlr_gles2_pixel_format {
 	bool has_alpha;
 };
 
+// Each batched quad is made of two triangles, each vertex holding a
+// position, a texture coordinate, a texture unit and an alpha value
+#define WLR_GLES2_BATCH_MAX_QUADS 128
+#define WLR_GLES2_BATCH_VERTEX_FLOATS 6
+#define WLR_GLES2_BATCH_QUAD_FLOATS (6 * WLR_GLES2_BATCH_VERTEX_FLOATS)
+// Textures sampled by a single batch, each bound to its own texture unit.
+// GLES 2.0 guarantees 8 units to fragment shaders, see shaders.c.
+#define WLR_GLES2_BATCH_TEX_UNITS 8
+
 struct wlr_gles2_tex_shader {
 	GLuint program;
-	GLint proj;
-	GLint invert_y;
-	GLint tex;
-	GLint alpha;
+	GLint tex[WLR_GLES2_BATCH_TEX_UNITS];
 	GLint pos_attrib;
 	GLint tex_attrib;
+	GLint unit_attrib;
+	GLint alpha_attrib;
 };
 
 struct wlr_gles2_renderer {
@@ -44,6 +54,10 @@ struct wlr_gles2_renderer {
 		bool egl_image_oes;
 	} exts;
 
+	// Pixel buffer objects and fence syncs are core in GLES 3.0, they
+	// allow reading pixels without stalling
+	bool gles3;
+
 	struct {
 		PFNGLEGLIMAGETARGETTEXTURE2DOESPROC glEGLImageTargetTexture2DOES;
 		PFNGLDEBUGMESSAGECALLBACKKHRPROC glDebugMessageCallbackKHR;
@@ -51,6 +65,12 @@ struct wlr_gles2_renderer {
 		PFNGLPOPDEBUGGROUPKHRPROC glPopDebugGroupKHR;
 		PFNGLPUSHDEBUGGROUPKHRPROC glPushDebugGroupKHR;
 		PFNGLEGLIMAGETARGETRENDERBUFFERSTORAGEOESPROC glEGLImageTargetRenderbufferStorageOES;
+		// GLES 3.0 core, same signatures as the extension variants
+		PFNGLMAPBUFFERRANGEEXTPROC glMapBufferRange;
+		PFNGLUNMAPBUFFEROESPROC glUnmapBuffer;
+		PFNGLFENCESYNCAPPLEPROC glFenceSync;
+		PFNGLCLIENTWAITSYNCAPPLEPROC glClientWaitSync;
+		PFNGLDELETESYNCAPPLEPROC glDeleteSync;
 	} procs;
 
 	struct {
@@ -73,6 +93,37 @@ struct wlr_gles2_renderer {
 	} shaders;
 
 	uint32_t viewport_width, viewport_height;
+
+	// Shadow copy of the GL state, see render/gles2/state.c
+	struct {
+		GLuint program;
+		GLenum active_texture;
+		// Bindings of the texture units used by batches
+		GLuint tex_2d[WLR_GLES2_BATCH_TEX_UNITS];
+		GLuint tex_external[WLR_GLES2_BATCH_TEX_UNITS];
+		GLuint array_buffer;
+		uint32_t attribs; // bitmask of enabled vertex attribute arrays
+
+		size_t skipped; // redundant GL calls skipped this frame
+		size_t draw_calls;
+	} state;
+
+	struct wlr_gles2_renderer_stats last_frame_stats;
+
+	// Consecutive textured quads sharing the same shader are accumulated
+	// here and submitted with a single draw call. Each quad samples one of
+	// the batch's textures, selected per vertex by its texture unit.
+	struct {
+		bool enabled;
+		GLuint vbo;
+
+		struct wlr_gles2_tex_shader *shader;
+		struct wlr_gles2_texture *textures[WLR_GLES2_BATCH_TEX_UNITS];
+		size_t textures_len;
+
+		size_t quads_len;
+		GLfloat verts[WLR_GLES2_BATCH_MAX_QUADS * WLR_GLES2_BATCH_QUAD_FLOATS];
+	} batch;
 };
 
 struct wlr_gles2_texture {
@@ -90,10 +141,43 @@ struct wlr_gles2_texture {
 	bool inverted_y;
 	bool has_alpha;
 
+	GLint min_filter; // last value set, 0 if unknown
+
 	// Only affects target == GL_TEXTURE_2D
 	enum wl_shm_format wl_format; // used to interpret upload data
 };
 
+struct wlr_gles2_readback {
+	struct wlr_renderer_readback wlr_readback;
+	struct wlr_gles2_renderer *renderer;
+
+	const struct wlr_gles2_pixel_format *fmt;
+	GLuint pbo;
+	const unsigned char *pixels; // pbo mapping, NULL until the first copy
+	GLsync fence;
+	// Same point as fence, exportable as a sync_file
+	EGLSyncKHR native_fence;
+};
+
+/**
+ * A renderer-native buffer: a renderbuffer with its own framebuffer object,
+ * only usable as a render target by the renderer which allocated it. It must
+ * not outlive the renderer.
+ */
+struct wlr_gles2_buffer {
+	struct wlr_buffer base;
+	struct wlr_gles2_renderer *renderer;
+
+	GLuint rbo, fbo;
+};
+
+struct wlr_gles2_allocator {
+	struct wlr_allocator base;
+	struct wlr_gles2_renderer *renderer;
+
+	GLenum internal_format;
+};
+
 const struct wlr_gles2_pixel_format *get_gles2_format_from_wl(
 	enum wl_shm_format fmt);
 const struct wlr_gles2_pixel_format *get_gles2_format_from_gl(
@@ -113,6 +197,40 @@ struct wlr_texture *gles2_texture_from_wl_drm(struct wlr_renderer *wlr_renderer,
 struct wlr_texture *gles2_texture_from_dmabuf(struct wlr_renderer *wlr_renderer,
 	struct wlr_dmabuf_attributes *attribs);
 
+struct wlr_allocator *gles2_allocator_create(struct wlr_renderer *wlr_renderer);
+/**
+ * Returns the framebuffer object of a buffer allocated by a GLES2 allocator,
+ * or 0 if the buffer comes from elsewhere.
+ */
+GLuint gles2_buffer_get_fbo(struct wlr_buffer *buffer);
+
+struct wlr_renderer_readback *gles2_read_pixels_async(
+	struct wlr_renderer *wlr_renderer, enum wl_shm_format wl_fmt,
+	uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y);
+
+void gles2_flush_batch(struct wlr_gles2_renderer *renderer);
+void gles2_flush_batch_texture(struct wlr_gles2_renderer *renderer,
+	struct wlr_gles2_texture *texture);
+
+void gles2_state_invalidate(struct wlr_gles2_renderer *renderer);
+/**
+ * Unbind the program, textures and buffers used by the renderer and forget
+ * the GL state, at the end of a render pass.
+ */
+void gles2_state_reset(struct wlr_gles2_renderer *renderer);
+void gles2_use_program(struct wlr_gles2_renderer *renderer, GLuint program);
+void gles2_active_texture(struct wlr_gles2_renderer *renderer, GLenum unit);
+void gles2_bind_texture(struct wlr_gles2_renderer *renderer, GLenum target,
+	GLuint tex);
+void gles2_delete_texture(struct wlr_gles2_renderer *renderer, GLenum target,
+	GLuint tex);
+void gles2_bind_array_buffer(struct wlr_gles2_renderer *renderer,
+	GLuint buffer);
+void gles2_set_attribs(struct wlr_gles2_renderer *renderer, uint32_t attribs);
+uint32_t gles2_attrib_bit(GLint location);
+void gles2_texture_set_min_filter(struct wlr_gles2_texture *texture,
+	GLint filter);
+
 void push_gles2_debug_(struct wlr_gles2_renderer *renderer,
 	const char *file, const char *func);
 #define push_gles2_debug(renderer) push_gles2_debug_(renderer, _WLR_FILENAME, __func__)
@@ -0,0 +1,56 @@
+#ifndef RENDER_SWAPCHAIN_H
+#define RENDER_SWAPCHAIN_H
+
+#include <stdbool.h>
+#include <wayland-server-core.h>
+#include <wlr/render/drm_format_set.h>
+
+#define WLR_SWAPCHAIN_CAP 4
+
+struct wlr_swapchain_slot {
+	struct wlr_buffer *buffer;
+	bool acquired; // waiting for release
+
+	int age;
+	struct wl_listener release;
+};
+
+/**
+ * A fixed-size pool of buffers sharing the same size and format. Buffers are
+ * allocated lazily and re-used once all of their consumers have released them.
+ */
+struct wlr_swapchain {
+	struct wlr_allocator *allocator; // NULL if destroyed
+
+	int width, height;
+	struct wlr_drm_format *format;
+
+	struct wlr_swapchain_slot slots[WLR_SWAPCHAIN_CAP];
+
+	struct wl_listener allocator_destroy;
+};
+
+struct wlr_swapchain *wlr_swapchain_create(
+	struct wlr_allocator *alloc, int width, int height,
+	const struct wlr_drm_format *format);
+void wlr_swapchain_destroy(struct wlr_swapchain *swapchain);
+/**
+ * Acquire a buffer from the swapchain. The returned buffer is locked, the
+ * caller must unlock it once done with it. NULL is returned if all slots are
+ * in use and no new buffer can be allocated.
+ *
+ * If age isn't NULL, it's set to the buffer age: the number of frames since
+ * the buffer contents were last submitted, or 0 if undefined.
+ */
+struct wlr_buffer *wlr_swapchain_acquire(struct wlr_swapchain *swapchain,
+	int *age);
+/**
+ * Mark the buffer as submitted for presentation. This needs to be called by
+ * swapchain users on each buffer submission to correctly track buffer ages.
+ *
+ * If the buffer doesn't belong to the swapchain, it's a no-op.
+ */
+void wlr_swapchain_set_buffer_submitted(struct wlr_swapchain *swapchain,
+	struct wlr_buffer *buffer);
+
+#endif
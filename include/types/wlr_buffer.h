@@ -0,0 +1,15 @@
+#ifndef TYPES_WLR_BUFFER_H
+#define TYPES_WLR_BUFFER_H
+
+#include <wlr/types/wlr_buffer.h>
+
+/**
+ * Upload the damaged regions of a wl_shm buffer into the client buffer's
+ * texture, then release the wl_shm buffer and make the client buffer refer to
+ * it. The caller must make sure the texture is mutable, has the same size and
+ * format as the wl_shm buffer and isn't being read by anyone else.
+ */
+bool client_buffer_upload_shm(struct wlr_client_buffer *buffer,
+	struct wl_resource *resource, pixman_region32_t *damage);
+
+#endif
@@ -13,6 +13,7 @@
 #include <wlr/backend.h>
 #include <wlr/backend/session.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/util/box.h>
 
 /**
  * Creates a DRM backend using the specified GPU file descriptor (typically from
@@ -35,4 +36,46 @@ typedef struct _drmModeModeInfo drmModeModeInfo;
 struct wlr_output_mode *wlr_drm_connector_add_mode(struct wlr_output *output,
 	const drmModeModeInfo *mode);
 
+/**
+ * Returns a sync_file fence signalled when the last committed frame starts
+ * being scanned out, or -1 if not available (e.g. with legacy modesetting).
+ * The caller is responsible for closing the returned file descriptor.
+ *
+ * This is meant for compositors handing the fence to other processes, e.g.
+ * to let a client know when a buffer it submitted reached the display.
+ * Within wlroots, present events already carry the page-flip timestamp, and
+ * the previous buffers are released on page-flip.
+ */
+int wlr_drm_connector_dup_out_fence(struct wlr_output *output);
+
+struct wlr_drm_overlay {
+	struct wlr_buffer *buffer;
+	// Destination on the output, in buffer-local coordinates. The buffer is
+	// scaled if the sizes don't match.
+	struct wlr_box dst;
+
+	// Set by wlr_drm_connector_test_overlays
+	bool accepted;
+};
+
+/**
+ * Proposes buffers to be scanned out on overlay planes with the next frame.
+ * The overlays are stacked above the primary plane in array order, the
+ * compositor must not propose a surface covered by content rendered on the
+ * primary plane.
+ *
+ * The backend assigns overlay planes starting from the top of the stack,
+ * using test-only atomic commits to check the format, modifier and scaling
+ * constraints. Proposals which don't fit aren't accepted and must be rendered
+ * as usual, as well as all the ones below them, to preserve the stacking
+ * order.
+ *
+ * Returns the number of accepted overlays. The assignment applies to the next
+ * commit with a buffer only: overlays need to be proposed again for each
+ * frame. Overlays are only supported with atomic modesetting, and once the
+ * output has displayed a frame.
+ */
+size_t wlr_drm_connector_test_overlays(struct wlr_output *output,
+	struct wlr_drm_overlay *overlays, size_t overlays_len);
+
 #endif
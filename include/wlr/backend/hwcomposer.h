@@ -3,6 +3,38 @@
 
 #include <wlr/backend.h>
 #include <wlr/types/wlr_output.h>
+#include <wlr/util/box.h>
+
+struct ANativeWindowBuffer;
+struct wlr_buffer;
+
+/**
+ * Returns the gralloc buffer backing a client buffer, or NULL if the client
+ * buffer isn't backed by one.
+ */
+typedef struct ANativeWindowBuffer *(*wlr_hwcomposer_import_buffer_func_t)(
+	struct wlr_buffer *buffer, void *data);
+
+enum wlr_hwcomposer_composition {
+	// The compositor must render the layer into the output buffer
+	WLR_HWCOMPOSER_COMPOSITION_CLIENT,
+	// The layer is presented by the display hardware
+	WLR_HWCOMPOSER_COMPOSITION_DEVICE,
+};
+
+/**
+ * A surface the compositor would like hwcomposer to present on its own
+ * display plane.
+ */
+struct wlr_hwcomposer_layer {
+	struct wlr_buffer *buffer;
+	struct wlr_box dst_box; // in output-buffer-local coordinates
+	enum wl_output_transform transform; // applied to the buffer
+	float alpha;
+
+	// Set by wlr_hwcomposer_output_set_layers
+	enum wlr_hwcomposer_composition composition;
+};
 
 /**
  * Creates a hwcomposer backend. A hwcomposer backend has no outputs or inputs by
@@ -28,6 +60,37 @@ void wlr_hwcomposer_output_schedule_destroy(struct wlr_output *wlr_output);
 void wlr_hwcomposer_backend_handle_hotplug(struct wlr_backend *wlr_backend,
 	uint64_t display, bool connected, bool primary_display);
 
+/**
+ * Sets the function used to get the gralloc buffers of client buffers
+ * attached with wlr_output_attach_buffer. Such buffers are then presented
+ * directly by hwcomposer, without GPU composition, whenever it supports it.
+ *
+ * By default, the buffers of libhybris clients are resolved if the EGL
+ * implementation supports EGL_HYBRIS_WL_acquire_native_buffer. Passing NULL
+ * disables direct scan-out.
+ */
+void wlr_hwcomposer_backend_set_import_buffer(struct wlr_backend *wlr_backend,
+	wlr_hwcomposer_import_buffer_func_t import_buffer, void *data);
+
+/**
+ * Sets the layers stacked above the output's rendered buffer, ordered bottom
+ * to top. Buffers are resolved with the function set with
+ * wlr_hwcomposer_backend_set_import_buffer.
+ *
+ * The display is validated right away and the composition of each layer is
+ * updated: layers with WLR_HWCOMPOSER_COMPOSITION_DEVICE must not be rendered
+ * by the compositor, the others must be rendered into the output buffer as
+ * usual. Layers rendered by the compositor end up below the others, so every
+ * layer below one of them is rendered by the compositor too. Layers are kept
+ * for the following commits, until this function is called again. Passing
+ * zero layers goes back to composing everything on the GPU.
+ *
+ * Returns false if hwcomposer can't present any layer, in which case all of
+ * them are set to WLR_HWCOMPOSER_COMPOSITION_CLIENT.
+ */
+bool wlr_hwcomposer_output_set_layers(struct wlr_output *wlr_output,
+	struct wlr_hwcomposer_layer *layers, size_t layers_len);
+
 bool wlr_backend_is_hwcomposer(struct wlr_backend *backend);
 bool wlr_output_is_hwcomposer(struct wlr_output *output);
 
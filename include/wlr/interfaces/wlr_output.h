@@ -93,6 +93,13 @@ struct wlr_output_impl {
 	 */
 	bool (*export_dmabuf)(struct wlr_output *output,
 		struct wlr_dmabuf_attributes *attribs);
+	/**
+	 * Get the number of buffers the output cycles through when rendering,
+	 * i.e. the maximum buffer age attach_render can report.
+	 *
+	 * Zero can be returned if unknown.
+	 */
+	size_t (*get_swapchain_len)(struct wlr_output *output);
 };
 
 /**
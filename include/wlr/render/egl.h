@@ -54,6 +54,7 @@ struct wlr_egl {
 		bool image_dma_buf_export_mesa;
 		bool image_dmabuf_import_ext;
 		bool image_dmabuf_import_modifiers_ext;
+		bool native_fence_sync_android;
 		bool swap_buffers_with_damage;
 	} exts;
 
@@ -72,6 +73,9 @@ struct wlr_egl {
 		PFNEGLEXPORTDMABUFIMAGEQUERYMESAPROC eglExportDMABUFImageQueryMESA;
 		PFNEGLEXPORTDMABUFIMAGEMESAPROC eglExportDMABUFImageMESA;
 		PFNEGLDEBUGMESSAGECONTROLKHRPROC eglDebugMessageControlKHR;
+		PFNEGLCREATESYNCKHRPROC eglCreateSyncKHR;
+		PFNEGLDESTROYSYNCKHRPROC eglDestroySyncKHR;
+		PFNEGLDUPNATIVEFENCEFDANDROIDPROC eglDupNativeFenceFDANDROID;
 	} procs;
 
 	struct wl_display *wl_display;
@@ -167,6 +171,21 @@ bool wlr_egl_set_damage_region(struct wlr_egl *egl, EGLSurface surface,
 bool wlr_egl_swap_buffers(struct wlr_egl *egl, EGLSurface surface,
 	pixman_region32_t *damage);
 
+/**
+ * Creates a native fence for the commands submitted so far in the current
+ * context. Returns EGL_NO_SYNC_KHR if EGL_ANDROID_native_fence_sync isn't
+ * supported.
+ */
+EGLSyncKHR wlr_egl_create_fence(struct wlr_egl *egl);
+
+/**
+ * Returns a sync_file file descriptor for the fence, owned by the caller, or
+ * -1 on error. The commands must have been flushed, e.g. by swapping buffers.
+ */
+int wlr_egl_dup_fence_fd(struct wlr_egl *egl, EGLSyncKHR sync);
+
+void wlr_egl_destroy_sync(struct wlr_egl *egl, EGLSyncKHR sync);
+
 bool wlr_egl_destroy_surface(struct wlr_egl *egl, EGLSurface surface);
 
 #endif
@@ -21,6 +21,19 @@ struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *renderer);
 bool wlr_gles2_renderer_check_ext(struct wlr_renderer *renderer,
 	const char *ext);
 
+struct wlr_gles2_renderer_stats {
+	size_t draw_calls;
+	// GL state changes skipped because the state was already set
+	size_t skipped_calls;
+};
+
+/**
+ * Get the statistics of the last completed render pass, i.e. the last
+ * wlr_renderer_begin/wlr_renderer_end pair.
+ */
+void wlr_gles2_renderer_get_stats(struct wlr_renderer *renderer,
+	struct wlr_gles2_renderer_stats *stats);
+
 struct wlr_gles2_texture_attribs {
 	GLenum target; /* either GL_TEXTURE_2D or GL_TEXTURE_EXTERNAL_OES */
 	GLuint tex;
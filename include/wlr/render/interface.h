@@ -72,6 +72,12 @@ struct wlr_renderer_impl {
 	bool (*blit_dmabuf)(struct wlr_renderer *renderer,
 		struct wlr_dmabuf_attributes *dst,
 		struct wlr_dmabuf_attributes *src);
+	struct wlr_renderer_readback *(*read_pixels_async)(
+		struct wlr_renderer *renderer, enum wl_shm_format fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y);
+	bool (*blit_dmabuf_region)(struct wlr_renderer *renderer,
+		struct wlr_dmabuf_attributes *dst, const struct wlr_box *dst_box,
+		struct wlr_dmabuf_attributes *src, const struct wlr_box *src_box);
 };
 
 void wlr_renderer_init(struct wlr_renderer *renderer,
@@ -91,4 +97,24 @@ struct wlr_texture_impl {
 void wlr_texture_init(struct wlr_texture *texture,
 	const struct wlr_texture_impl *impl, uint32_t width, uint32_t height);
 
+struct wlr_renderer_readback_impl {
+	bool (*is_done)(struct wlr_renderer_readback *readback);
+	bool (*copy)(struct wlr_renderer_readback *readback,
+		uint32_t stride, uint32_t width, uint32_t height,
+		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
+		void *data);
+	int (*get_fence_fd)(struct wlr_renderer_readback *readback);
+	void (*destroy)(struct wlr_renderer_readback *readback);
+};
+
+struct wlr_renderer_readback {
+	const struct wlr_renderer_readback_impl *impl;
+	enum wl_shm_format format;
+	uint32_t width, height;
+};
+
+void wlr_renderer_readback_init(struct wlr_renderer_readback *readback,
+	const struct wlr_renderer_readback_impl *impl, enum wl_shm_format fmt,
+	uint32_t width, uint32_t height);
+
 #endif
@@ -19,6 +19,7 @@ enum wlr_renderer_read_pixels_flags {
 };
 
 struct wlr_renderer_impl;
+struct wlr_renderer_readback;
 struct wlr_drm_format_set;
 struct wlr_box;
 struct wlr_fbox;
@@ -112,12 +113,53 @@ const struct wlr_drm_format_set *wlr_renderer_get_dmabuf_formats(
 bool wlr_renderer_read_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
 	uint32_t *flags, uint32_t stride, uint32_t width, uint32_t height,
 	uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y, void *data);
+/**
+ * Starts reading out pixels of the currently bound surface without waiting
+ * for the GPU to finish rendering. Returns NULL if the renderer doesn't
+ * support asynchronous read-back, in which case wlr_renderer_read_pixels
+ * should be used instead.
+ *
+ * Once wlr_renderer_readback_is_done returns true, the pixels can be
+ * retrieved with wlr_renderer_readback_copy.
+ */
+struct wlr_renderer_readback *wlr_renderer_read_pixels_async(
+	struct wlr_renderer *r, enum wl_shm_format fmt, uint32_t width,
+	uint32_t height, uint32_t src_x, uint32_t src_y);
+/**
+ * Checks whether the GPU has completed the read-back. Never blocks.
+ */
+bool wlr_renderer_readback_is_done(struct wlr_renderer_readback *readback);
+/**
+ * Returns a sync_file FD which becomes readable once the GPU has completed
+ * the read-back, or -1 if the renderer can't provide one. The caller is
+ * responsible for closing the FD.
+ */
+int wlr_renderer_readback_get_fence_fd(struct wlr_renderer_readback *readback);
+/**
+ * Copies pixels of a completed read-back into data. `src_x` and `src_y` are
+ * relative to the area passed to wlr_renderer_read_pixels_async, `stride` is
+ * in bytes. Rows are always written top to bottom.
+ */
+bool wlr_renderer_readback_copy(struct wlr_renderer_readback *readback,
+	uint32_t stride, uint32_t width, uint32_t height, uint32_t src_x,
+	uint32_t src_y, uint32_t dst_x, uint32_t dst_y, void *data);
+void wlr_renderer_readback_destroy(struct wlr_renderer_readback *readback);
 
 /**
  * Blits the dmabuf in src onto the one in dst.
  */
 bool wlr_renderer_blit_dmabuf(struct wlr_renderer *r,
 	struct wlr_dmabuf_attributes *dst, struct wlr_dmabuf_attributes *src);
+/**
+ * Blits the src_box rectangle of the dmabuf in src onto the dst_box rectangle
+ * of the one in dst, scaling it if the sizes of the boxes differ. A NULL box
+ * designates the whole buffer. Boxes are in buffer coordinates, with the
+ * origin at the top-left corner of the buffer contents. The rest of dst is
+ * left untouched.
+ */
+bool wlr_renderer_blit_dmabuf_region(struct wlr_renderer *r,
+	struct wlr_dmabuf_attributes *dst, const struct wlr_box *dst_box,
+	struct wlr_dmabuf_attributes *src, const struct wlr_box *src_box);
 /**
  * Checks if a format is supported.
  */
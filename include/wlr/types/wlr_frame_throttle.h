@@ -0,0 +1,74 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_FRAME_THROTTLE_H
+#define WLR_TYPES_WLR_FRAME_THROTTLE_H
+
+#include <stdbool.h>
+#include <time.h>
+#include <wayland-server-core.h>
+
+struct wlr_surface;
+
+/**
+ * Throttles frame callbacks of surfaces which aren't visible.
+ *
+ * Compositors report the visibility of surfaces with
+ * `wlr_frame_throttle_set_visible` (e.g. from the output layout and
+ * `wlr_occlusion_compute`) and send frame callbacks with
+ * `wlr_frame_throttle_send_frame_done` instead of
+ * `wlr_surface_send_frame_done`. Frame callbacks of hidden surfaces are then
+ * sent at most every `hidden_interval` milliseconds, and as soon as the
+ * surface becomes visible again.
+ */
+struct wlr_frame_throttle {
+	// Minimum delay between two frame callbacks of a hidden surface, in
+	// milliseconds. Zero holds the callbacks until the surface becomes
+	// visible.
+	int hidden_interval;
+
+	struct wl_list surfaces; // wlr_frame_throttle_surface::link
+	struct wl_event_source *timer;
+
+	struct {
+		struct wl_signal destroy;
+	} events;
+
+	struct wl_listener display_destroy;
+};
+
+/**
+ * A hidden surface.
+ */
+struct wlr_frame_throttle_surface {
+	struct wlr_frame_throttle *throttle;
+	struct wlr_surface *surface;
+	struct wl_list link; // wlr_frame_throttle::surfaces
+
+	struct timespec last_done; // last time frame callbacks were sent
+
+	struct wl_listener surface_destroy;
+};
+
+struct wlr_frame_throttle *wlr_frame_throttle_create(
+	struct wl_display *display);
+/**
+ * Updates the visibility of a surface. Surfaces are visible by default. Frame
+ * callbacks held back while the surface was hidden are sent right away when it
+ * becomes visible.
+ */
+void wlr_frame_throttle_set_visible(struct wlr_frame_throttle *throttle,
+	struct wlr_surface *surface, bool visible);
+/**
+ * Sends the frame callbacks of a surface if it's visible, or if its last frame
+ * callbacks were sent long enough ago.
+ */
+void wlr_frame_throttle_send_frame_done(struct wlr_frame_throttle *throttle,
+	struct wlr_surface *surface, const struct timespec *when);
+
+#endif
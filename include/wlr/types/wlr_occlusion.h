@@ -0,0 +1,60 @@
+/*
+ * This an unstable interface of wlroots. No guarantees are made regarding the
+ * future consistency of this API.
+ */
+#ifndef WLR_USE_UNSTABLE
+#error "Add -DWLR_USE_UNSTABLE to enable unstable wlroots features"
+#endif
+
+#ifndef WLR_TYPES_WLR_OCCLUSION_H
+#define WLR_TYPES_WLR_OCCLUSION_H
+
+#include <pixman.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct wlr_output;
+struct wlr_surface;
+
+/**
+ * A surface of an output's stack, as used by `wlr_occlusion_compute`.
+ */
+struct wlr_occlusion_surface {
+	struct wlr_surface *surface;
+	int x, y; // position of the surface, in output-local layout coordinates
+
+	// Set to true if the surface is drawn with some transparency (e.g. with
+	// an alpha below 1), in which case its opaque region is ignored
+	bool translucent;
+
+	// Part of the surface that needs to be repainted, in output buffer
+	// coordinates like the damage. Must be initialized by the caller.
+	pixman_region32_t visible;
+};
+
+/**
+ * Computes the part of each surface of a stack that needs to be repainted.
+ *
+ * `surfaces` is ordered bottom to top, i.e. in rendering order. Surfaces are
+ * walked front to back: each surface's visible region is the part of `damage`
+ * it covers and which isn't hidden by the opaque region of a surface above.
+ * Surfaces with an empty visible region are fully occluded and don't need to
+ * be rendered.
+ *
+ * Surface positions are in output-local layout coordinates, while `damage`
+ * is in output buffer coordinates: surfaces are transformed by the output's
+ * transform and scaled by its scale before being compared to the damage. If
+ * `output` is NULL, both use the same coordinate space, without scaling
+ * relative to surface-local coordinates.
+ *
+ * If `uncovered` isn't NULL, it is set to the part of `damage` which isn't
+ * hidden by any opaque surface, i.e. the part which still needs to be cleared
+ * before rendering the surfaces, in output buffer coordinates.
+ *
+ * Returns the number of surfaces which aren't fully occluded.
+ */
+size_t wlr_occlusion_compute(struct wlr_output *output,
+	struct wlr_occlusion_surface *surfaces, size_t surfaces_len,
+	pixman_region32_t *damage, pixman_region32_t *uncovered);
+
+#endif
@@ -385,6 +385,11 @@ void wlr_output_schedule_frame(struct wlr_output *output);
  * Returns the maximum length of each gamma ramp, or 0 if unsupported.
  */
 size_t wlr_output_get_gamma_size(struct wlr_output *output);
+/**
+ * Returns the number of buffers the output cycles through when rendering, or
+ * 0 if unknown.
+ */
+size_t wlr_output_get_swapchain_len(struct wlr_output *output);
 /**
  * Sets the gamma table for this output. `r`, `g` and `b` are gamma ramps for
  * red, green and blue. `size` is the length of the ramps and must not exceed
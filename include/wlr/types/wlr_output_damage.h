@@ -10,18 +10,26 @@
 #define WLR_TYPES_WLR_OUTPUT_DAMAGE_H
 
 #include <pixman.h>
+#include <stdint.h>
 #include <time.h>
 #include <wlr/types/wlr_output.h>
 
 /**
  * Damage tracking requires to keep track of previous frames' damage. To allow
  * damage tracking to work with triple buffering, a history of two frames is
- * required.
+ * required. This is the default history length, used when the output doesn't
+ * report its swapchain length.
  */
 #define WLR_OUTPUT_DAMAGE_PREVIOUS_LEN 2
 
 struct wlr_box;
 
+struct wlr_output_damage_stats {
+	int rects; // number of rectangles to repaint
+	uint64_t damaged_pixels; // pixels actually damaged
+	uint64_t repainted_pixels; // pixels to repaint, including merging waste
+};
+
 /**
  * Tracks damage for an output.
  *
@@ -36,13 +44,21 @@ struct wlr_box;
 struct wlr_output_damage {
 	struct wlr_output *output;
 	int max_rects; // max number of damaged rectangles
+	// Number of pixels worth an additional damaged rectangle: nearby
+	// rectangles are merged as long as it repaints fewer extra pixels. Zero
+	// by default, which disables merging.
+	int rect_cost;
 
 	pixman_region32_t current; // in output-local coordinates
 
 	// circular queue for previous damage
-	pixman_region32_t previous[WLR_OUTPUT_DAMAGE_PREVIOUS_LEN];
+	pixman_region32_t *previous;
+	size_t previous_len;
 	size_t previous_idx;
 
+	// Statistics of the last wlr_output_damage_attach_render call
+	struct wlr_output_damage_stats stats;
+
 	struct {
 		struct wl_signal frame;
 		struct wl_signal destroy;
@@ -58,7 +74,18 @@ struct wlr_output_damage {
 	struct wl_listener output_commit;
 };
 
+/**
+ * Creates damage tracking for an output. The damage history is sized from the
+ * output's swapchain length, if known.
+ */
 struct wlr_output_damage *wlr_output_damage_create(struct wlr_output *output);
+/**
+ * Creates damage tracking for an output, keeping the damage of the
+ * `previous_len` previous frames. Buffers older than `previous_len + 1` frames
+ * are fully repainted.
+ */
+struct wlr_output_damage *wlr_output_damage_create_with_len(
+	struct wlr_output *output, size_t previous_len);
 void wlr_output_damage_destroy(struct wlr_output_damage *output_damage);
 /**
  * Attach the renderer's buffer to the output. Compositors must call this
@@ -107,6 +107,12 @@ struct wlr_surface {
 	 * the surface bounds.
 	 */
 	pixman_region32_t input_region;
+	/**
+	 * The wl_shm buffers recently attached to the surface, along with their
+	 * texture. When a client cycles between a few wl_shm buffers, only the
+	 * regions damaged since a buffer was last attached need to be uploaded.
+	 */
+	struct wl_list shm_cache;
 	/**
 	 * `current` contains the current, committed surface state. `pending`
 	 * accumulates state changes from the client between commits and shouldn't
@@ -18,6 +18,7 @@
 #define WLR_UTIL_REGION_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <pixman.h>
 #include <wayland-server-protocol.h>
 
@@ -56,4 +57,21 @@ void wlr_region_rotated_bounds(pixman_region32_t *dst, pixman_region32_t *src,
 bool wlr_region_confine(pixman_region32_t *region, double x1, double y1, double x2,
 	double y2, double *x2_out, double *y2_out);
 
+/**
+ * Returns the number of pixels covered by the region.
+ */
+uint64_t wlr_region_area(pixman_region32_t *region);
+
+/**
+ * Reduces the number of rectangles of a region by merging nearby rectangles
+ * into their bounding box, which grows the region.
+ *
+ * `rect_cost` is the number of pixels an additional rectangle is worth: two
+ * rectangles are merged as long as it adds fewer pixels to the region.
+ * Rectangles are merged regardless of the cost while there are more than
+ * `max_rects` of them.
+ */
+void wlr_region_simplify(pixman_region32_t *dst, pixman_region32_t *src,
+	int max_rects, int rect_cost);
+
 #endif
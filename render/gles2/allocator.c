@@ -0,0 +1,144 @@
+#include <assert.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdlib.h>
+#include <wlr/render/egl.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+
+static const struct wlr_buffer_impl buffer_impl;
+
+static struct wlr_gles2_buffer *gles2_buffer_from_buffer(
+		struct wlr_buffer *wlr_buffer) {
+	assert(wlr_buffer->impl == &buffer_impl);
+	return (struct wlr_gles2_buffer *)wlr_buffer;
+}
+
+GLuint gles2_buffer_get_fbo(struct wlr_buffer *wlr_buffer) {
+	if (wlr_buffer->impl != &buffer_impl) {
+		return 0;
+	}
+	return gles2_buffer_from_buffer(wlr_buffer)->fbo;
+}
+
+static void buffer_destroy(struct wlr_buffer *wlr_buffer) {
+	struct wlr_gles2_buffer *buffer = gles2_buffer_from_buffer(wlr_buffer);
+	struct wlr_gles2_renderer *renderer = buffer->renderer;
+
+	struct wlr_egl_context old_context;
+	wlr_egl_save_context(&old_context);
+	wlr_egl_make_current(renderer->egl, EGL_NO_SURFACE, NULL);
+
+	push_gles2_debug(renderer);
+	glDeleteFramebuffers(1, &buffer->fbo);
+	glDeleteRenderbuffers(1, &buffer->rbo);
+	pop_gles2_debug(renderer);
+
+	wlr_egl_restore_context(&old_context);
+	free(buffer);
+}
+
+static const struct wlr_buffer_impl buffer_impl = {
+	.destroy = buffer_destroy,
+};
+
+static const struct wlr_allocator_interface allocator_impl;
+
+static struct wlr_gles2_allocator *gles2_allocator_from_allocator(
+		struct wlr_allocator *wlr_allocator) {
+	assert(wlr_allocator->impl == &allocator_impl);
+	return (struct wlr_gles2_allocator *)wlr_allocator;
+}
+
+static struct wlr_buffer *allocator_create_buffer(
+		struct wlr_allocator *wlr_allocator, int width, int height,
+		const struct wlr_drm_format *format) {
+	struct wlr_gles2_allocator *allocator =
+		gles2_allocator_from_allocator(wlr_allocator);
+	struct wlr_gles2_renderer *renderer = allocator->renderer;
+
+	// Renderbuffers have no memory layout visible to the outside: the
+	// modifiers are ignored and the format only picks the storage
+	struct wlr_gles2_buffer *buffer = calloc(1, sizeof(*buffer));
+	if (buffer == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_buffer_init(&buffer->base, &buffer_impl, width, height);
+	buffer->renderer = renderer;
+
+	struct wlr_egl_context old_context;
+	wlr_egl_save_context(&old_context);
+	if (!wlr_egl_make_current(renderer->egl, EGL_NO_SURFACE, NULL)) {
+		free(buffer);
+		return NULL;
+	}
+
+	push_gles2_debug(renderer);
+
+	glGenRenderbuffers(1, &buffer->rbo);
+	glBindRenderbuffer(GL_RENDERBUFFER, buffer->rbo);
+	glRenderbufferStorage(GL_RENDERBUFFER, allocator->internal_format,
+		width, height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	glGenFramebuffers(1, &buffer->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, buffer->fbo);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+		GL_RENDERBUFFER, buffer->rbo);
+	GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	pop_gles2_debug(renderer);
+
+	if (status != GL_FRAMEBUFFER_COMPLETE) {
+		wlr_log(WLR_ERROR, "Failed to create FBO");
+		glDeleteFramebuffers(1, &buffer->fbo);
+		glDeleteRenderbuffers(1, &buffer->rbo);
+		wlr_egl_restore_context(&old_context);
+		free(buffer);
+		return NULL;
+	}
+
+	wlr_egl_restore_context(&old_context);
+
+	wlr_log(WLR_DEBUG, "Allocated %dx%d GLES2 renderbuffer", width, height);
+	return &buffer->base;
+}
+
+static void allocator_destroy(struct wlr_allocator *wlr_allocator) {
+	struct wlr_gles2_allocator *allocator =
+		gles2_allocator_from_allocator(wlr_allocator);
+	free(allocator);
+}
+
+static const struct wlr_allocator_interface allocator_impl = {
+	.destroy = allocator_destroy,
+	.create_buffer = allocator_create_buffer,
+};
+
+struct wlr_allocator *gles2_allocator_create(struct wlr_renderer *wlr_renderer) {
+	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
+
+	struct wlr_gles2_allocator *allocator = calloc(1, sizeof(*allocator));
+	if (allocator == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_allocator_init(&allocator->base, &allocator_impl);
+	allocator->renderer = renderer;
+
+	if (wlr_gles2_renderer_check_ext(wlr_renderer, "GL_OES_rgb8_rgba8") ||
+			wlr_gles2_renderer_check_ext(wlr_renderer,
+				"GL_OES_required_internalformat") ||
+			wlr_gles2_renderer_check_ext(wlr_renderer, "GL_ARM_rgba8")) {
+		allocator->internal_format = GL_RGBA8_OES;
+	} else {
+		wlr_log(WLR_INFO, "GL_RGBA8_OES not supported, "
+			"falling back to GL_RGBA4 internal format "
+			"(performance may be affected)");
+		allocator->internal_format = GL_RGBA4;
+	}
+
+	return &allocator->base;
+}
@@ -0,0 +1,227 @@
+#include <assert.h>
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/render/egl.h>
+#include <wlr/render/interface.h>
+#include <wlr/util/log.h>
+#include "render/gles2.h"
+
+// GLES 3.0 core enums, not available in the GLES2 headers
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+#ifndef GL_STREAM_READ
+#define GL_STREAM_READ 0x88E1
+#endif
+#ifndef GL_MAP_READ_BIT
+#define GL_MAP_READ_BIT 0x0001
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+static const struct wlr_renderer_readback_impl readback_impl;
+
+static struct wlr_gles2_readback *gles2_get_readback(
+		struct wlr_renderer_readback *wlr_readback) {
+	assert(wlr_readback->impl == &readback_impl);
+	return (struct wlr_gles2_readback *)wlr_readback;
+}
+
+static bool gles2_readback_is_done(struct wlr_renderer_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+
+	if (readback->fence == NULL) {
+		return true;
+	}
+
+	struct wlr_egl_context old_context;
+	wlr_egl_save_context(&old_context);
+	wlr_egl_make_current(renderer->egl, EGL_NO_SURFACE, NULL);
+
+	// A zero timeout only polls the fence
+	GLenum status = renderer->procs.glClientWaitSync(readback->fence, 0, 0);
+	bool done = status == GL_ALREADY_SIGNALED ||
+		status == GL_CONDITION_SATISFIED;
+	if (done) {
+		renderer->procs.glDeleteSync(readback->fence);
+		readback->fence = NULL;
+	}
+
+	wlr_egl_restore_context(&old_context);
+	return done;
+}
+
+static bool gles2_readback_copy(struct wlr_renderer_readback *wlr_readback,
+		uint32_t stride, uint32_t width, uint32_t height,
+		uint32_t src_x, uint32_t src_y, uint32_t dst_x, uint32_t dst_y,
+		void *data) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+	const struct wlr_gles2_pixel_format *fmt = readback->fmt;
+
+	uint32_t pack_stride = wlr_readback->width * fmt->bpp / 8;
+
+	// The buffer is mapped on the first copy and stays mapped until the
+	// read-back is destroyed, so that copying many boxes costs one mapping
+	if (readback->pixels == NULL) {
+		struct wlr_egl_context old_context;
+		wlr_egl_save_context(&old_context);
+		wlr_egl_make_current(renderer->egl, EGL_NO_SURFACE, NULL);
+
+		push_gles2_debug(renderer);
+
+		size_t size = (size_t)pack_stride * wlr_readback->height;
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+		readback->pixels = renderer->procs.glMapBufferRange(
+			GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+		pop_gles2_debug(renderer);
+
+		wlr_egl_restore_context(&old_context);
+
+		if (readback->pixels == NULL) {
+			wlr_log(WLR_ERROR, "Failed to map pixel buffer object");
+			return false;
+		}
+	}
+
+	// The GL origin is the bottom-left corner, flip the rows while copying
+	unsigned char *p = (unsigned char *)data + dst_y * stride +
+		dst_x * fmt->bpp / 8;
+	size_t row_size = width * fmt->bpp / 8;
+	for (size_t i = 0; i < height; ++i) {
+		size_t row = wlr_readback->height - src_y - i - 1;
+		memcpy(p + i * stride,
+			readback->pixels + row * pack_stride + src_x * fmt->bpp / 8,
+			row_size);
+	}
+	return true;
+}
+
+static int gles2_readback_get_fence_fd(
+		struct wlr_renderer_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	if (readback->native_fence == EGL_NO_SYNC_KHR) {
+		return -1;
+	}
+	return wlr_egl_dup_fence_fd(readback->renderer->egl,
+		readback->native_fence);
+}
+
+static void gles2_readback_destroy(struct wlr_renderer_readback *wlr_readback) {
+	struct wlr_gles2_readback *readback = gles2_get_readback(wlr_readback);
+	struct wlr_gles2_renderer *renderer = readback->renderer;
+
+	struct wlr_egl_context old_context;
+	wlr_egl_save_context(&old_context);
+	wlr_egl_make_current(renderer->egl, EGL_NO_SURFACE, NULL);
+
+	push_gles2_debug(renderer);
+	if (readback->fence != NULL) {
+		renderer->procs.glDeleteSync(readback->fence);
+	}
+	if (readback->pixels != NULL) {
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+		renderer->procs.glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+	}
+	glDeleteBuffers(1, &readback->pbo);
+	pop_gles2_debug(renderer);
+	wlr_egl_destroy_sync(renderer->egl, readback->native_fence);
+
+	wlr_egl_restore_context(&old_context);
+	free(readback);
+}
+
+static const struct wlr_renderer_readback_impl readback_impl = {
+	.is_done = gles2_readback_is_done,
+	.copy = gles2_readback_copy,
+	.get_fence_fd = gles2_readback_get_fence_fd,
+	.destroy = gles2_readback_destroy,
+};
+
+struct wlr_renderer_readback *gles2_read_pixels_async(
+		struct wlr_renderer *wlr_renderer, enum wl_shm_format wl_fmt,
+		uint32_t width, uint32_t height, uint32_t src_x, uint32_t src_y) {
+	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
+	assert(wlr_egl_is_current(renderer->egl));
+
+	if (!renderer->gles3) {
+		return NULL;
+	}
+
+	const struct wlr_gles2_pixel_format *fmt = get_gles2_format_from_wl(wl_fmt);
+	if (fmt == NULL) {
+		wlr_log(WLR_ERROR, "Cannot read pixels: unsupported pixel format");
+		return NULL;
+	}
+
+	if (fmt->gl_format == GL_BGRA_EXT && !renderer->exts.read_format_bgra_ext) {
+		wlr_log(WLR_ERROR,
+			"Cannot read pixels: missing GL_EXT_read_format_bgra extension");
+		return NULL;
+	}
+
+	struct wlr_gles2_readback *readback =
+		calloc(1, sizeof(struct wlr_gles2_readback));
+	if (readback == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return NULL;
+	}
+	wlr_renderer_readback_init(&readback->wlr_readback, &readback_impl,
+		wl_fmt, width, height);
+	readback->renderer = renderer;
+	readback->fmt = fmt;
+
+	gles2_flush_batch(renderer);
+
+	push_gles2_debug(renderer);
+
+	glGetError(); // Clear the error flag
+
+	size_t size = (size_t)width * height * fmt->bpp / 8;
+	glGenBuffers(1, &readback->pbo);
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+	glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+
+	// With a pixel pack buffer bound, the last argument is an offset into
+	// the buffer and glReadPixels returns without waiting for the GPU
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+	glReadPixels(src_x, renderer->viewport_height - height - src_y,
+		width, height, fmt->gl_format, fmt->gl_type, NULL);
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+	glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+	readback->fence =
+		renderer->procs.glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	// Lets callers wait on a file descriptor instead of polling the fence,
+	// EGL_NO_SYNC_KHR without EGL_ANDROID_native_fence_sync
+	readback->native_fence = wlr_egl_create_fence(renderer->egl);
+	// Make sure the fences get submitted, they would never signal otherwise
+	glFlush();
+
+	bool ok = glGetError() == GL_NO_ERROR && readback->fence != NULL;
+
+	pop_gles2_debug(renderer);
+
+	if (!ok) {
+		wlr_log(WLR_ERROR, "Failed to start asynchronous pixel read-back");
+		gles2_readback_destroy(&readback->wlr_readback);
+		return NULL;
+	}
+
+	return &readback->wlr_readback;
+}
@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wayland-server-protocol.h>
 #include <wayland-util.h>
 #include <wlr/render/egl.h>
@@ -42,6 +43,14 @@ static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer_in_context(wlr_renderer);
 
+	gles2_flush_batch(renderer);
+
+	// The GL context may have been used by someone else since the last
+	// render pass
+	gles2_state_invalidate(renderer);
+	renderer->state.skipped = 0;
+	renderer->state.draw_calls = 0;
+
 	push_gles2_debug(renderer);
 
 	glViewport(0, 0, width, height);
@@ -59,8 +68,18 @@ static void gles2_begin(struct wlr_renderer *wlr_renderer, uint32_t width,
 }
 
 static void gles2_end(struct wlr_renderer *wlr_renderer) {
-	gles2_get_renderer_in_context(wlr_renderer);
-	// no-op
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer_in_context(wlr_renderer);
+	gles2_flush_batch(renderer);
+
+	// Leave the context in the state GL users outside of the renderer
+	// expect
+	push_gles2_debug(renderer);
+	gles2_state_reset(renderer);
+	pop_gles2_debug(renderer);
+
+	renderer->last_frame_stats.draw_calls = renderer->state.draw_calls;
+	renderer->last_frame_stats.skipped_calls = renderer->state.skipped;
 }
 
 static void gles2_clear(struct wlr_renderer *wlr_renderer,
@@ -68,6 +87,8 @@ static void gles2_clear(struct wlr_renderer *wlr_renderer,
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer_in_context(wlr_renderer);
 
+	gles2_flush_batch(renderer);
+
 	push_gles2_debug(renderer);
 	glClearColor(color[0], color[1], color[2], color[3]);
 	glClear(GL_COLOR_BUFFER_BIT);
@@ -79,6 +100,8 @@ static void gles2_scissor(struct wlr_renderer *wlr_renderer,
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer_in_context(wlr_renderer);
 
+	gles2_flush_batch(renderer);
+
 	push_gles2_debug(renderer);
 	if (box != NULL) {
 		struct wlr_box gl_box;
@@ -93,6 +116,94 @@ static void gles2_scissor(struct wlr_renderer *wlr_renderer,
 	pop_gles2_debug(renderer);
 }
 
+void gles2_flush_batch(struct wlr_gles2_renderer *renderer) {
+	if (renderer->batch.quads_len == 0) {
+		return;
+	}
+
+	struct wlr_gles2_tex_shader *shader = renderer->batch.shader;
+
+	push_gles2_debug(renderer);
+
+	// The texture of index i is sampled from unit i
+	for (size_t i = 0; i < renderer->batch.textures_len; i++) {
+		struct wlr_gles2_texture *texture = renderer->batch.textures[i];
+		gles2_active_texture(renderer, GL_TEXTURE0 + i);
+		gles2_bind_texture(renderer, texture->target, texture->tex);
+		gles2_texture_set_min_filter(texture, GL_LINEAR);
+	}
+
+	gles2_use_program(renderer, shader->program);
+
+	size_t verts_len = renderer->batch.quads_len * 6;
+	GLsizei vert_stride = WLR_GLES2_BATCH_VERTEX_FLOATS * sizeof(GLfloat);
+
+	// Uploading a single quad to the VBO would only add a buffer upload on
+	// top of the draw call, so client-side arrays are used unless several
+	// quads got batched together
+	uintptr_t base;
+	if (renderer->batch.quads_len == 1) {
+		gles2_bind_array_buffer(renderer, 0);
+		base = (uintptr_t)renderer->batch.verts;
+	} else {
+		gles2_bind_array_buffer(renderer, renderer->batch.vbo);
+		glBufferData(GL_ARRAY_BUFFER, verts_len * vert_stride,
+			renderer->batch.verts, GL_STREAM_DRAW);
+		base = 0;
+	}
+
+	glVertexAttribPointer(shader->pos_attrib, 2, GL_FLOAT, GL_FALSE,
+		vert_stride, (const GLvoid *)base);
+	glVertexAttribPointer(shader->tex_attrib, 2, GL_FLOAT, GL_FALSE,
+		vert_stride, (const GLvoid *)(base + 2 * sizeof(GLfloat)));
+	glVertexAttribPointer(shader->unit_attrib, 1, GL_FLOAT, GL_FALSE,
+		vert_stride, (const GLvoid *)(base + 4 * sizeof(GLfloat)));
+	glVertexAttribPointer(shader->alpha_attrib, 1, GL_FLOAT, GL_FALSE,
+		vert_stride, (const GLvoid *)(base + 5 * sizeof(GLfloat)));
+
+	gles2_set_attribs(renderer, gles2_attrib_bit(shader->pos_attrib) |
+		gles2_attrib_bit(shader->tex_attrib) |
+		gles2_attrib_bit(shader->unit_attrib) |
+		gles2_attrib_bit(shader->alpha_attrib));
+
+	glDrawArrays(GL_TRIANGLES, 0, verts_len);
+	renderer->state.draw_calls++;
+
+	pop_gles2_debug(renderer);
+
+	renderer->batch.quads_len = 0;
+	renderer->batch.textures_len = 0;
+}
+
+void gles2_flush_batch_texture(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_texture *texture) {
+	for (size_t i = 0; i < renderer->batch.textures_len; i++) {
+		if (renderer->batch.textures[i] == texture) {
+			gles2_flush_batch(renderer);
+			return;
+		}
+	}
+}
+
+/**
+ * Get the texture unit the batch samples the texture from, adding the
+ * texture to the batch if needed.
+ */
+static size_t batch_get_texture_unit(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_texture *texture) {
+	for (size_t i = 0; i < renderer->batch.textures_len; i++) {
+		if (renderer->batch.textures[i] == texture) {
+			return i;
+		}
+	}
+
+	if (renderer->batch.textures_len == WLR_GLES2_BATCH_TEX_UNITS) {
+		gles2_flush_batch(renderer);
+	}
+	renderer->batch.textures[renderer->batch.textures_len] = texture;
+	return renderer->batch.textures_len++;
+}
+
 static bool gles2_render_subtexture_with_matrix(
 		struct wlr_renderer *wlr_renderer, struct wlr_texture *wlr_texture,
 		const struct wlr_fbox *box, const float matrix[static 9],
@@ -125,50 +236,52 @@ static bool gles2_render_subtexture_with_matrix(
 		abort();
 	}
 
-	// OpenGL ES 2 requires the glUniformMatrix3fv transpose parameter to be set
-	// to GL_FALSE
-	float transposition[9];
-	wlr_matrix_transpose(transposition, matrix);
-
-	push_gles2_debug(renderer);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(texture->target, texture->tex);
-
-	glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	if (renderer->batch.quads_len > 0 &&
+			(renderer->batch.shader != shader ||
+			renderer->batch.quads_len == WLR_GLES2_BATCH_MAX_QUADS)) {
+		gles2_flush_batch(renderer);
+	}
 
-	glUseProgram(shader->program);
+	renderer->batch.shader = shader;
+	GLfloat unit = batch_get_texture_unit(renderer, texture);
 
-	glUniformMatrix3fv(shader->proj, 1, GL_FALSE, transposition);
-	glUniform1i(shader->invert_y, texture->inverted_y);
-	glUniform1i(shader->tex, 0);
-	glUniform1f(shader->alpha, alpha);
+	GLfloat x1 = box->x / wlr_texture->width;
+	GLfloat y1 = box->y / wlr_texture->height;
+	GLfloat x2 = (box->x + box->width) / wlr_texture->width;
+	GLfloat y2 = (box->y + box->height) / wlr_texture->height;
+	if (texture->inverted_y) {
+		y1 = 1 - y1;
+		y2 = 1 - y2;
+	}
 
-	const GLfloat x1 = box->x / wlr_texture->width;
-	const GLfloat y1 = box->y / wlr_texture->height;
-	const GLfloat x2 = (box->x + box->width) / wlr_texture->width;
-	const GLfloat y2 = (box->y + box->height) / wlr_texture->height;
+	// The projection is applied here rather than in the vertex shader, so
+	// that quads with different matrices can share a single draw call
 	const GLfloat texcoord[] = {
 		x2, y1, // top right
 		x1, y1, // top left
 		x2, y2, // bottom right
 		x1, y2, // bottom left
 	};
+	static const int strip_to_triangles[] = { 0, 1, 2, 2, 1, 3 };
 
-	glVertexAttribPointer(shader->pos_attrib, 2, GL_FLOAT, GL_FALSE, 0, verts);
-	glVertexAttribPointer(shader->tex_attrib, 2, GL_FLOAT, GL_FALSE, 0, texcoord);
-
-	glEnableVertexAttribArray(shader->pos_attrib);
-	glEnableVertexAttribArray(shader->tex_attrib);
-
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	glDisableVertexAttribArray(shader->pos_attrib);
-	glDisableVertexAttribArray(shader->tex_attrib);
+	GLfloat *v = &renderer->batch.verts[
+		renderer->batch.quads_len * WLR_GLES2_BATCH_QUAD_FLOATS];
+	for (size_t i = 0; i < 6; i++) {
+		int j = strip_to_triangles[i];
+		GLfloat x = verts[2 * j], y = verts[2 * j + 1];
+		*v++ = matrix[0] * x + matrix[1] * y + matrix[2];
+		*v++ = matrix[3] * x + matrix[4] * y + matrix[5];
+		*v++ = texcoord[2 * j];
+		*v++ = texcoord[2 * j + 1];
+		*v++ = unit;
+		*v++ = alpha;
+	}
+	renderer->batch.quads_len++;
 
-	glBindTexture(texture->target, 0);
+	if (!renderer->batch.enabled) {
+		gles2_flush_batch(renderer);
+	}
 
-	pop_gles2_debug(renderer);
 	return true;
 }
 
@@ -182,20 +295,23 @@ static void gles2_render_quad_with_matrix(struct wlr_renderer *wlr_renderer,
 	float transposition[9];
 	wlr_matrix_transpose(transposition, matrix);
 
+	gles2_flush_batch(renderer);
+
 	push_gles2_debug(renderer);
-	glUseProgram(renderer->shaders.quad.program);
+	gles2_use_program(renderer, renderer->shaders.quad.program);
 
 	glUniformMatrix3fv(renderer->shaders.quad.proj, 1, GL_FALSE, transposition);
 	glUniform4f(renderer->shaders.quad.color, color[0], color[1], color[2], color[3]);
 
+	gles2_bind_array_buffer(renderer, 0);
 	glVertexAttribPointer(renderer->shaders.quad.pos_attrib, 2, GL_FLOAT, GL_FALSE,
 			0, verts);
 
-	glEnableVertexAttribArray(renderer->shaders.quad.pos_attrib);
+	gles2_set_attribs(renderer,
+		gles2_attrib_bit(renderer->shaders.quad.pos_attrib));
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-
-	glDisableVertexAttribArray(renderer->shaders.quad.pos_attrib);
+	renderer->state.draw_calls++;
 
 	pop_gles2_debug(renderer);
 }
@@ -217,24 +333,27 @@ static void gles2_render_ellipse_with_matrix(struct wlr_renderer *wlr_renderer,
 		0, 1, // bottom left
 	};
 
+	gles2_flush_batch(renderer);
+
 	push_gles2_debug(renderer);
-	glUseProgram(renderer->shaders.ellipse.program);
+	gles2_use_program(renderer, renderer->shaders.ellipse.program);
 
 	glUniformMatrix3fv(renderer->shaders.ellipse.proj, 1, GL_FALSE, transposition);
 	glUniform4f(renderer->shaders.ellipse.color, color[0], color[1], color[2], color[3]);
 
+	gles2_bind_array_buffer(renderer, 0);
 	glVertexAttribPointer(renderer->shaders.ellipse.pos_attrib, 2, GL_FLOAT,
 			GL_FALSE, 0, verts);
 	glVertexAttribPointer(renderer->shaders.ellipse.tex_attrib, 2, GL_FLOAT,
 			GL_FALSE, 0, texcoord);
 
-	glEnableVertexAttribArray(renderer->shaders.ellipse.pos_attrib);
-	glEnableVertexAttribArray(renderer->shaders.ellipse.tex_attrib);
+	gles2_set_attribs(renderer,
+		gles2_attrib_bit(renderer->shaders.ellipse.pos_attrib) |
+		gles2_attrib_bit(renderer->shaders.ellipse.tex_attrib));
 
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	renderer->state.draw_calls++;
 
-	glDisableVertexAttribArray(renderer->shaders.ellipse.pos_attrib);
-	glDisableVertexAttribArray(renderer->shaders.ellipse.tex_attrib);
 	pop_gles2_debug(renderer);
 }
 
@@ -331,6 +450,8 @@ static bool gles2_read_pixels(struct wlr_renderer *wlr_renderer,
 		return false;
 	}
 
+	gles2_flush_batch(renderer);
+
 	push_gles2_debug(renderer);
 
 	// Make sure any pending drawing is finished before we try to read it
@@ -363,14 +484,20 @@ static bool gles2_read_pixels(struct wlr_renderer *wlr_renderer,
 	return glGetError() == GL_NO_ERROR;
 }
 
-static bool gles2_blit_dmabuf(struct wlr_renderer *wlr_renderer,
-		struct wlr_dmabuf_attributes *dst_attr,
-		struct wlr_dmabuf_attributes *src_attr) {
+static bool gles2_blit_dmabuf_region(struct wlr_renderer *wlr_renderer,
+		struct wlr_dmabuf_attributes *dst_attr, const struct wlr_box *dst_box,
+		struct wlr_dmabuf_attributes *src_attr, const struct wlr_box *src_box) {
 	struct wlr_gles2_renderer *renderer = gles2_get_renderer(wlr_renderer);
 	if (!renderer->procs.glEGLImageTargetRenderbufferStorageOES) {
 		return false;
 	}
 
+	// Quads queued for the current render target must not end up in the
+	// destination buffer
+	if (wlr_egl_is_current(renderer->egl)) {
+		gles2_flush_batch(renderer);
+	}
+
 	struct wlr_egl_context old_context;
 	wlr_egl_save_context(&old_context);
 
@@ -423,13 +550,34 @@ static bool gles2_blit_dmabuf(struct wlr_renderer *wlr_renderer,
 		goto out;
 	}
 
+	// The projection y-inverts the rendered quad, and so does the source
+	// texture unless both buffers have the same orientation: the boxes are
+	// flipped accordingly when the destination isn't y-inverted
+	struct wlr_box quad_box = *dst_box;
+	struct wlr_fbox tex_box = {
+		.x = src_box->x,
+		.y = src_box->y,
+		.width = src_box->width,
+		.height = src_box->height,
+	};
+	if (!dst_inverted_y) {
+		quad_box.y = dst_attr->height - dst_box->y - dst_box->height;
+		tex_box.y = src_attr->height - src_box->y - src_box->height;
+	}
+
 	// TODO: use ANGLE_framebuffer_blit if available
-	float mat[9];
-	wlr_matrix_projection(mat, 1, 1, WL_OUTPUT_TRANSFORM_NORMAL);
+	float projection[9], mat[9];
+	wlr_matrix_projection(projection, dst_attr->width, dst_attr->height,
+		WL_OUTPUT_TRANSFORM_NORMAL);
+	wlr_matrix_project_box(mat, &quad_box, WL_OUTPUT_TRANSFORM_NORMAL, 0,
+		projection);
 
 	wlr_renderer_begin(wlr_renderer, dst_attr->width, dst_attr->height);
+	wlr_renderer_scissor(wlr_renderer, &quad_box);
 	wlr_renderer_clear(wlr_renderer, (float[]){ 0.0, 0.0, 0.0, 0.0 });
-	wlr_render_texture_with_matrix(wlr_renderer, src_tex, mat, 1.0f);
+	wlr_renderer_scissor(wlr_renderer, NULL);
+	wlr_render_subtexture_with_matrix(wlr_renderer, src_tex, &tex_box, mat,
+		1.0f);
 	wlr_renderer_end(wlr_renderer);
 
 	r = true;
@@ -470,6 +618,13 @@ static bool gles2_init_wl_display(struct wlr_renderer *wlr_renderer,
 	return true;
 }
 
+void wlr_gles2_renderer_get_stats(struct wlr_renderer *wlr_renderer,
+		struct wlr_gles2_renderer_stats *stats) {
+	struct wlr_gles2_renderer *renderer =
+		gles2_get_renderer(wlr_renderer);
+	*stats = renderer->last_frame_stats;
+}
+
 struct wlr_egl *wlr_gles2_renderer_get_egl(struct wlr_renderer *wlr_renderer) {
 	struct wlr_gles2_renderer *renderer =
 		gles2_get_renderer(wlr_renderer);
@@ -482,6 +637,7 @@ static void gles2_destroy(struct wlr_renderer *wlr_renderer) {
 	wlr_egl_make_current(renderer->egl, EGL_NO_SURFACE, NULL);
 
 	push_gles2_debug(renderer);
+	glDeleteBuffers(1, &renderer->batch.vbo);
 	glDeleteProgram(renderer->shaders.quad.program);
 	glDeleteProgram(renderer->shaders.ellipse.program);
 	glDeleteProgram(renderer->shaders.tex_rgba.program);
@@ -519,7 +675,8 @@ static const struct wlr_renderer_impl renderer_impl = {
 	.texture_from_wl_drm = gles2_texture_from_wl_drm,
 	.texture_from_dmabuf = gles2_texture_from_dmabuf,
 	.init_wl_display = gles2_init_wl_display,
-	.blit_dmabuf = gles2_blit_dmabuf,
+	.read_pixels_async = gles2_read_pixels_async,
+	.blit_dmabuf_region = gles2_blit_dmabuf_region,
 };
 
 void push_gles2_debug_(struct wlr_gles2_renderer *renderer,
@@ -654,6 +811,33 @@ extern const GLchar tex_fragment_src_rgba[];
 extern const GLchar tex_fragment_src_rgbx[];
 extern const GLchar tex_fragment_src_external[];
 
+static bool init_tex_shader(struct wlr_gles2_renderer *renderer,
+		struct wlr_gles2_tex_shader *shader, const GLchar *frag_src) {
+	GLuint prog = shader->program =
+		link_program(renderer, tex_vertex_src, frag_src);
+	if (!prog) {
+		return false;
+	}
+
+	shader->pos_attrib = glGetAttribLocation(prog, "pos");
+	shader->tex_attrib = glGetAttribLocation(prog, "texcoord");
+	shader->unit_attrib = glGetAttribLocation(prog, "texunit");
+	shader->alpha_attrib = glGetAttribLocation(prog, "alpha");
+
+	// Batched textures are bound to the units of their index, so the
+	// samplers never change afterwards
+	glUseProgram(prog);
+	for (size_t i = 0; i < WLR_GLES2_BATCH_TEX_UNITS; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "tex%zu", i);
+		shader->tex[i] = glGetUniformLocation(prog, name);
+		glUniform1i(shader->tex[i], i);
+	}
+	glUseProgram(0);
+
+	return true;
+}
+
 struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 	if (!wlr_egl_make_current(egl, EGL_NO_SURFACE, NULL)) {
 		return NULL;
@@ -709,6 +893,20 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 			"glEGLImageTargetRenderbufferStorageOES");
 	}
 
+	// Contexts created for GLES2 are often GLES3 in practice
+	int gl_major = 0;
+	const char *gl_version = (const char *)glGetString(GL_VERSION);
+	if (gl_version != NULL &&
+			sscanf(gl_version, "OpenGL ES %d.", &gl_major) == 1 &&
+			gl_major >= 3) {
+		renderer->gles3 = true;
+		load_gl_proc(&renderer->procs.glMapBufferRange, "glMapBufferRange");
+		load_gl_proc(&renderer->procs.glUnmapBuffer, "glUnmapBuffer");
+		load_gl_proc(&renderer->procs.glFenceSync, "glFenceSync");
+		load_gl_proc(&renderer->procs.glClientWaitSync, "glClientWaitSync");
+		load_gl_proc(&renderer->procs.glDeleteSync, "glDeleteSync");
+	}
+
 	if (renderer->exts.debug_khr) {
 		glEnable(GL_DEBUG_OUTPUT_KHR);
 		glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS_KHR);
@@ -743,42 +941,28 @@ struct wlr_renderer *wlr_gles2_renderer_create(struct wlr_egl *egl) {
 	renderer->shaders.ellipse.pos_attrib = glGetAttribLocation(prog, "pos");
 	renderer->shaders.ellipse.tex_attrib = glGetAttribLocation(prog, "texcoord");
 
-	renderer->shaders.tex_rgba.program = prog =
-		link_program(renderer, tex_vertex_src, tex_fragment_src_rgba);
-	if (!renderer->shaders.tex_rgba.program) {
+	if (!init_tex_shader(renderer, &renderer->shaders.tex_rgba,
+			tex_fragment_src_rgba)) {
 		goto error;
 	}
-	renderer->shaders.tex_rgba.proj = glGetUniformLocation(prog, "proj");
-	renderer->shaders.tex_rgba.invert_y = glGetUniformLocation(prog, "invert_y");
-	renderer->shaders.tex_rgba.tex = glGetUniformLocation(prog, "tex");
-	renderer->shaders.tex_rgba.alpha = glGetUniformLocation(prog, "alpha");
-	renderer->shaders.tex_rgba.pos_attrib = glGetAttribLocation(prog, "pos");
-	renderer->shaders.tex_rgba.tex_attrib = glGetAttribLocation(prog, "texcoord");
-
-	renderer->shaders.tex_rgbx.program = prog =
-		link_program(renderer, tex_vertex_src, tex_fragment_src_rgbx);
-	if (!renderer->shaders.tex_rgbx.program) {
+	if (!init_tex_shader(renderer, &renderer->shaders.tex_rgbx,
+			tex_fragment_src_rgbx)) {
 		goto error;
 	}
-	renderer->shaders.tex_rgbx.proj = glGetUniformLocation(prog, "proj");
-	renderer->shaders.tex_rgbx.invert_y = glGetUniformLocation(prog, "invert_y");
-	renderer->shaders.tex_rgbx.tex = glGetUniformLocation(prog, "tex");
-	renderer->shaders.tex_rgbx.alpha = glGetUniformLocation(prog, "alpha");
-	renderer->shaders.tex_rgbx.pos_attrib = glGetAttribLocation(prog, "pos");
-	renderer->shaders.tex_rgbx.tex_attrib = glGetAttribLocation(prog, "texcoord");
-
-	if (renderer->exts.egl_image_external_oes) {
-		renderer->shaders.tex_ext.program = prog =
-			link_program(renderer, tex_vertex_src, tex_fragment_src_external);
-		if (!renderer->shaders.tex_ext.program) {
-			goto error;
-		}
-		renderer->shaders.tex_ext.proj = glGetUniformLocation(prog, "proj");
-		renderer->shaders.tex_ext.invert_y = glGetUniformLocation(prog, "invert_y");
-		renderer->shaders.tex_ext.tex = glGetUniformLocation(prog, "tex");
-		renderer->shaders.tex_ext.alpha = glGetUniformLocation(prog, "alpha");
-		renderer->shaders.tex_ext.pos_attrib = glGetAttribLocation(prog, "pos");
-		renderer->shaders.tex_ext.tex_attrib = glGetAttribLocation(prog, "texcoord");
+	if (renderer->exts.egl_image_external_oes &&
+			!init_tex_shader(renderer, &renderer->shaders.tex_ext,
+			tex_fragment_src_external)) {
+		goto error;
+	}
+
+	glGenBuffers(1, &renderer->batch.vbo);
+
+	gles2_state_invalidate(renderer);
+
+	const char *no_batch = getenv("WLR_GLES2_NO_BATCH");
+	renderer->batch.enabled = !(no_batch && strcmp(no_batch, "1") == 0);
+	if (!renderer->batch.enabled) {
+		wlr_log(WLR_DEBUG, "Textured quad batching disabled");
 	}
 
 	pop_gles2_debug(renderer);
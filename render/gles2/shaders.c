@@ -39,50 +39,75 @@ const GLchar ellipse_fragment_src[] =
 "	gl_FragColor = v_color;\n"
 "}\n";
 
-// Textured quads
+// Textured quads. The vertices are already projected, each one selects the
+// texture unit to sample from: a batch draws quads of up to 8 textures at
+// once, WLR_GLES2_BATCH_TEX_UNITS. Samplers can only be indexed by constant
+// expressions in GLSL ES 1.00, hence the branches.
 const GLchar tex_vertex_src[] =
-"uniform mat3 proj;\n"
-"uniform bool invert_y;\n"
 "attribute vec2 pos;\n"
 "attribute vec2 texcoord;\n"
+"attribute float texunit;\n"
+"attribute float alpha;\n"
 "varying vec2 v_texcoord;\n"
+"varying float v_texunit;\n"
+"varying float v_alpha;\n"
 "\n"
 "void main() {\n"
-"	gl_Position = vec4(proj * vec3(pos, 1.0), 1.0);\n"
-"	if (invert_y) {\n"
-"		v_texcoord = vec2(texcoord.x, 1.0 - texcoord.y);\n"
-"	} else {\n"
-"		v_texcoord = texcoord;\n"
-"	}\n"
+"	gl_Position = vec4(pos, 1.0, 1.0);\n"
+"	v_texcoord = texcoord;\n"
+"	v_texunit = texunit;\n"
+"	v_alpha = alpha;\n"
 "}\n";
 
-const GLchar tex_fragment_src_rgba[] =
-"precision mediump float;\n"
-"varying vec2 v_texcoord;\n"
-"uniform sampler2D tex;\n"
-"uniform float alpha;\n"
+#define TEX_FRAGMENT_SAMPLE(sampler) \
+"precision mediump float;\n" \
+"varying vec2 v_texcoord;\n" \
+"varying float v_texunit;\n" \
+"varying float v_alpha;\n" \
+"uniform " sampler " tex0;\n" \
+"uniform " sampler " tex1;\n" \
+"uniform " sampler " tex2;\n" \
+"uniform " sampler " tex3;\n" \
+"uniform " sampler " tex4;\n" \
+"uniform " sampler " tex5;\n" \
+"uniform " sampler " tex6;\n" \
+"uniform " sampler " tex7;\n" \
+"\n" \
+"vec4 sample_texture() {\n" \
+"	if (v_texunit < 0.5) {\n" \
+"		return texture2D(tex0, v_texcoord);\n" \
+"	} else if (v_texunit < 1.5) {\n" \
+"		return texture2D(tex1, v_texcoord);\n" \
+"	} else if (v_texunit < 2.5) {\n" \
+"		return texture2D(tex2, v_texcoord);\n" \
+"	} else if (v_texunit < 3.5) {\n" \
+"		return texture2D(tex3, v_texcoord);\n" \
+"	} else if (v_texunit < 4.5) {\n" \
+"		return texture2D(tex4, v_texcoord);\n" \
+"	} else if (v_texunit < 5.5) {\n" \
+"		return texture2D(tex5, v_texcoord);\n" \
+"	} else if (v_texunit < 6.5) {\n" \
+"		return texture2D(tex6, v_texcoord);\n" \
+"	}\n" \
+"	return texture2D(tex7, v_texcoord);\n" \
+"}\n" \
 "\n"
+
+const GLchar tex_fragment_src_rgba[] =
+TEX_FRAGMENT_SAMPLE("sampler2D")
 "void main() {\n"
-"	gl_FragColor = texture2D(tex, v_texcoord) * alpha;\n"
+"	gl_FragColor = sample_texture() * v_alpha;\n"
 "}\n";
 
 const GLchar tex_fragment_src_rgbx[] =
-"precision mediump float;\n"
-"varying vec2 v_texcoord;\n"
-"uniform sampler2D tex;\n"
-"uniform float alpha;\n"
-"\n"
+TEX_FRAGMENT_SAMPLE("sampler2D")
 "void main() {\n"
-"	gl_FragColor = vec4(texture2D(tex, v_texcoord).rgb, 1.0) * alpha;\n"
+"	gl_FragColor = vec4(sample_texture().rgb, 1.0) * v_alpha;\n"
 "}\n";
 
 const GLchar tex_fragment_src_external[] =
 "#extension GL_OES_EGL_image_external : require\n\n"
-"precision mediump float;\n"
-"varying vec2 v_texcoord;\n"
-"uniform samplerExternalOES tex;\n"
-"uniform float alpha;\n"
-"\n"
+TEX_FRAGMENT_SAMPLE("samplerExternalOES")
 "void main() {\n"
-"	gl_FragColor = texture2D(tex, v_texcoord) * alpha;\n"
+"	gl_FragColor = sample_texture() * v_alpha;\n"
 "}\n";
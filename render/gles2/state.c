@@ -0,0 +1,175 @@
+#include <GLES2/gl2.h>
+#include <GLES2/gl2ext.h>
+#include <stdint.h>
+#include "render/gles2.h"
+
+/*
+ * Shadow copy of the GL state touched by the renderer. Every helper below
+ * only issues the GL call when the requested state differs from the one
+ * currently known to be set, and counts the calls it could skip.
+ */
+
+#define STATE_UNKNOWN ((GLuint)-1)
+
+void gles2_state_invalidate(struct wlr_gles2_renderer *renderer) {
+	renderer->state.program = STATE_UNKNOWN;
+	renderer->state.active_texture = STATE_UNKNOWN;
+	for (size_t i = 0; i < WLR_GLES2_BATCH_TEX_UNITS; i++) {
+		renderer->state.tex_2d[i] = STATE_UNKNOWN;
+		renderer->state.tex_external[i] = STATE_UNKNOWN;
+	}
+	renderer->state.array_buffer = STATE_UNKNOWN;
+	// Vertex attribute arrays are always disabled at the end of a render
+	// pass, see gles2_state_reset
+	renderer->state.attribs = 0;
+}
+
+void gles2_state_reset(struct wlr_gles2_renderer *renderer) {
+	gles2_set_attribs(renderer, 0);
+	gles2_bind_array_buffer(renderer, 0);
+
+	for (size_t i = 0; i < WLR_GLES2_BATCH_TEX_UNITS; i++) {
+		GLuint tex_2d = renderer->state.tex_2d[i];
+		GLuint tex_external = renderer->state.tex_external[i];
+		// Units left untouched by the render pass are left as they were
+		if ((tex_2d == 0 || tex_2d == STATE_UNKNOWN) &&
+				(tex_external == 0 || tex_external == STATE_UNKNOWN)) {
+			continue;
+		}
+
+		gles2_active_texture(renderer, GL_TEXTURE0 + i);
+		if (tex_2d != 0 && tex_2d != STATE_UNKNOWN) {
+			gles2_bind_texture(renderer, GL_TEXTURE_2D, 0);
+		}
+		if (tex_external != 0 && tex_external != STATE_UNKNOWN) {
+			gles2_bind_texture(renderer, GL_TEXTURE_EXTERNAL_OES, 0);
+		}
+	}
+	if (renderer->state.active_texture != STATE_UNKNOWN) {
+		gles2_active_texture(renderer, GL_TEXTURE0);
+	}
+	if (renderer->state.program != STATE_UNKNOWN) {
+		gles2_use_program(renderer, 0);
+	}
+
+	// Other GL users of the context may change the state before the next
+	// render pass
+	gles2_state_invalidate(renderer);
+}
+
+void gles2_use_program(struct wlr_gles2_renderer *renderer, GLuint program) {
+	if (renderer->state.program == program) {
+		renderer->state.skipped++;
+		return;
+	}
+	glUseProgram(program);
+	renderer->state.program = program;
+}
+
+void gles2_active_texture(struct wlr_gles2_renderer *renderer, GLenum unit) {
+	if (renderer->state.active_texture == unit) {
+		renderer->state.skipped++;
+		return;
+	}
+	glActiveTexture(unit);
+	renderer->state.active_texture = unit;
+}
+
+static GLuint *unit_texture_binding(struct wlr_gles2_renderer *renderer,
+		GLenum target, size_t unit) {
+	switch (target) {
+	case GL_TEXTURE_2D:
+		return &renderer->state.tex_2d[unit];
+	case GL_TEXTURE_EXTERNAL_OES:
+		return &renderer->state.tex_external[unit];
+	default:
+		return NULL;
+	}
+}
+
+// Bindings are per texture unit, only the active one is affected
+static GLuint *texture_binding(struct wlr_gles2_renderer *renderer,
+		GLenum target) {
+	GLenum active = renderer->state.active_texture;
+	if (active == STATE_UNKNOWN || active < GL_TEXTURE0 ||
+			active >= GL_TEXTURE0 + WLR_GLES2_BATCH_TEX_UNITS) {
+		return NULL;
+	}
+	return unit_texture_binding(renderer, target, active - GL_TEXTURE0);
+}
+
+void gles2_bind_texture(struct wlr_gles2_renderer *renderer, GLenum target,
+		GLuint tex) {
+	GLuint *binding = texture_binding(renderer, target);
+	if (binding == NULL) {
+		glBindTexture(target, tex);
+		return;
+	}
+	if (*binding == tex) {
+		renderer->state.skipped++;
+		return;
+	}
+	glBindTexture(target, tex);
+	*binding = tex;
+}
+
+void gles2_delete_texture(struct wlr_gles2_renderer *renderer, GLenum target,
+		GLuint tex) {
+	glDeleteTextures(1, &tex);
+
+	// Deleting a bound texture reverts the bindings to zero in every unit
+	for (size_t i = 0; i < WLR_GLES2_BATCH_TEX_UNITS; i++) {
+		GLuint *binding = unit_texture_binding(renderer, target, i);
+		if (binding != NULL && *binding == tex) {
+			*binding = 0;
+		}
+	}
+}
+
+void gles2_bind_array_buffer(struct wlr_gles2_renderer *renderer,
+		GLuint buffer) {
+	if (renderer->state.array_buffer == buffer) {
+		renderer->state.skipped++;
+		return;
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	renderer->state.array_buffer = buffer;
+}
+
+void gles2_set_attribs(struct wlr_gles2_renderer *renderer, uint32_t attribs) {
+	uint32_t changed = renderer->state.attribs ^ attribs;
+	for (GLuint i = 0; i < 32; i++) {
+		uint32_t bit = (uint32_t)1 << i;
+		if (!(changed & bit)) {
+			if (attribs & bit) {
+				renderer->state.skipped++;
+			}
+			continue;
+		}
+
+		if (attribs & bit) {
+			glEnableVertexAttribArray(i);
+		} else {
+			glDisableVertexAttribArray(i);
+		}
+	}
+	renderer->state.attribs = attribs;
+}
+
+uint32_t gles2_attrib_bit(GLint location) {
+	if (location < 0 || location >= 32) {
+		return 0;
+	}
+	return (uint32_t)1 << location;
+}
+
+void gles2_texture_set_min_filter(struct wlr_gles2_texture *texture,
+		GLint filter) {
+	struct wlr_gles2_renderer *renderer = texture->renderer;
+	if (texture->min_filter == filter) {
+		renderer->state.skipped++;
+		return;
+	}
+	glTexParameteri(texture->target, GL_TEXTURE_MIN_FILTER, filter);
+	texture->min_filter = filter;
+}
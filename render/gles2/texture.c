@@ -29,6 +29,11 @@ struct wlr_gles2_texture *gles2_get_texture(
 static struct wlr_gles2_texture *get_gles2_texture_in_context(
 		struct wlr_texture *wlr_texture) {
 	struct wlr_gles2_texture *texture = gles2_get_texture(wlr_texture);
+	// Quads referencing this texture may still be queued for the current
+	// render target: submit them before the texture is modified
+	if (wlr_egl_is_current(texture->renderer->egl)) {
+		gles2_flush_batch_texture(texture->renderer, texture);
+	}
 	wlr_egl_make_current(texture->renderer->egl, EGL_NO_SURFACE, NULL);
 	return texture;
 }
@@ -58,7 +63,7 @@ static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 	// TODO: what if the unpack subimage extension isn't supported?
 	push_gles2_debug(texture->renderer);
 
-	glBindTexture(GL_TEXTURE_2D, texture->tex);
+	gles2_bind_texture(texture->renderer, GL_TEXTURE_2D, texture->tex);
 
 	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / (fmt->bpp / 8));
 	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, src_x);
@@ -71,7 +76,7 @@ static bool gles2_texture_write_pixels(struct wlr_texture *wlr_texture,
 	glPixelStorei(GL_UNPACK_SKIP_PIXELS_EXT, 0);
 	glPixelStorei(GL_UNPACK_SKIP_ROWS_EXT, 0);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	gles2_bind_texture(texture->renderer, GL_TEXTURE_2D, 0);
 
 	pop_gles2_debug(texture->renderer);
 
@@ -117,7 +122,7 @@ static void gles2_texture_destroy(struct wlr_texture *wlr_texture) {
 
 	push_gles2_debug(texture->renderer);
 
-	glDeleteTextures(1, &texture->tex);
+	gles2_delete_texture(texture->renderer, texture->target, texture->tex);
 	wlr_egl_destroy_image(texture->renderer->egl, texture->image);
 
 	pop_gles2_debug(texture->renderer);
@@ -162,14 +167,14 @@ struct wlr_texture *gles2_texture_from_pixels(struct wlr_renderer *wlr_renderer,
 	push_gles2_debug(renderer);
 
 	glGenTextures(1, &texture->tex);
-	glBindTexture(GL_TEXTURE_2D, texture->tex);
+	gles2_bind_texture(renderer, GL_TEXTURE_2D, texture->tex);
 
 	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, stride / (fmt->bpp / 8));
 	glTexImage2D(GL_TEXTURE_2D, 0, fmt->gl_format, width, height, 0,
 		fmt->gl_format, fmt->gl_type, data);
 	glPixelStorei(GL_UNPACK_ROW_LENGTH_EXT, 0);
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	gles2_bind_texture(renderer, GL_TEXTURE_2D, 0);
 
 	pop_gles2_debug(renderer);
 
@@ -231,10 +236,10 @@ struct wlr_texture *gles2_texture_from_wl_drm(struct wlr_renderer *wlr_renderer,
 	push_gles2_debug(renderer);
 
 	glGenTextures(1, &texture->tex);
-	glBindTexture(GL_TEXTURE_EXTERNAL_OES, texture->tex);
+	gles2_bind_texture(renderer, GL_TEXTURE_EXTERNAL_OES, texture->tex);
 	renderer->procs.glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES,
 		texture->image);
-	glBindTexture(GL_TEXTURE_EXTERNAL_OES, 0);
+	gles2_bind_texture(renderer, GL_TEXTURE_EXTERNAL_OES, 0);
 
 	pop_gles2_debug(renderer);
 
@@ -298,9 +303,9 @@ struct wlr_texture *gles2_texture_from_dmabuf(struct wlr_renderer *wlr_renderer,
 	push_gles2_debug(renderer);
 
 	glGenTextures(1, &texture->tex);
-	glBindTexture(texture->target, texture->tex);
+	gles2_bind_texture(renderer, texture->target, texture->tex);
 	renderer->procs.glEGLImageTargetTexture2DOES(texture->target, texture->image);
-	glBindTexture(texture->target, 0);
+	gles2_bind_texture(renderer, texture->target, 0);
 
 	pop_gles2_debug(renderer);
 
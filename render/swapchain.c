@@ -0,0 +1,154 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <wlr/types/wlr_buffer.h>
+#include <wlr/util/log.h>
+#include "render/allocator.h"
+#include "render/swapchain.h"
+
+static void swapchain_handle_allocator_destroy(struct wl_listener *listener,
+		void *data) {
+	struct wlr_swapchain *swapchain =
+		wl_container_of(listener, swapchain, allocator_destroy);
+	swapchain->allocator = NULL;
+	wl_list_remove(&swapchain->allocator_destroy.link);
+	wl_list_init(&swapchain->allocator_destroy.link);
+}
+
+struct wlr_swapchain *wlr_swapchain_create(
+		struct wlr_allocator *alloc, int width, int height,
+		const struct wlr_drm_format *format) {
+	struct wlr_swapchain *swapchain = calloc(1, sizeof(*swapchain));
+	if (swapchain == NULL) {
+		return NULL;
+	}
+	swapchain->allocator = alloc;
+	swapchain->width = width;
+	swapchain->height = height;
+
+	size_t format_size = sizeof(struct wlr_drm_format) +
+		format->len * sizeof(format->modifiers[0]);
+	swapchain->format = malloc(format_size);
+	if (swapchain->format == NULL) {
+		free(swapchain);
+		return NULL;
+	}
+	memcpy(swapchain->format, format, format_size);
+	swapchain->format->cap = format->len;
+
+	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
+		wl_list_init(&swapchain->slots[i].release.link);
+	}
+
+	swapchain->allocator_destroy.notify = swapchain_handle_allocator_destroy;
+	wl_signal_add(&alloc->events.destroy, &swapchain->allocator_destroy);
+
+	return swapchain;
+}
+
+static void slot_reset(struct wlr_swapchain_slot *slot) {
+	if (slot->buffer == NULL) {
+		return;
+	}
+	wl_list_remove(&slot->release.link);
+	wlr_buffer_drop(slot->buffer);
+	memset(slot, 0, sizeof(*slot));
+	wl_list_init(&slot->release.link);
+}
+
+void wlr_swapchain_destroy(struct wlr_swapchain *swapchain) {
+	if (swapchain == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
+		slot_reset(&swapchain->slots[i]);
+	}
+	wl_list_remove(&swapchain->allocator_destroy.link);
+	free(swapchain->format);
+	free(swapchain);
+}
+
+static void slot_handle_release(struct wl_listener *listener, void *data) {
+	struct wlr_swapchain_slot *slot =
+		wl_container_of(listener, slot, release);
+	slot->acquired = false;
+}
+
+static struct wlr_buffer *slot_acquire(struct wlr_swapchain_slot *slot,
+		int *age) {
+	assert(!slot->acquired);
+	assert(slot->buffer != NULL);
+
+	slot->acquired = true;
+	if (age != NULL) {
+		*age = slot->age;
+	}
+
+	return wlr_buffer_lock(slot->buffer);
+}
+
+struct wlr_buffer *wlr_swapchain_acquire(struct wlr_swapchain *swapchain,
+		int *age) {
+	struct wlr_swapchain_slot *free_slot = NULL;
+	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
+		struct wlr_swapchain_slot *slot = &swapchain->slots[i];
+		if (slot->acquired) {
+			continue;
+		}
+		if (slot->buffer != NULL) {
+			return slot_acquire(slot, age);
+		}
+		if (free_slot == NULL) {
+			free_slot = slot;
+		}
+	}
+	if (free_slot == NULL) {
+		wlr_log(WLR_ERROR, "No free output buffer slot");
+		return NULL;
+	}
+
+	if (swapchain->allocator == NULL) {
+		return NULL;
+	}
+
+	wlr_log(WLR_DEBUG, "Allocating new swapchain buffer");
+	free_slot->buffer = wlr_allocator_create_buffer(swapchain->allocator,
+		swapchain->width, swapchain->height, swapchain->format);
+	if (free_slot->buffer == NULL) {
+		wlr_log(WLR_ERROR, "Failed to allocate buffer");
+		return NULL;
+	}
+
+	free_slot->age = 0;
+	free_slot->release.notify = slot_handle_release;
+	wl_signal_add(&free_slot->buffer->events.release, &free_slot->release);
+
+	return slot_acquire(free_slot, age);
+}
+
+void wlr_swapchain_set_buffer_submitted(struct wlr_swapchain *swapchain,
+		struct wlr_buffer *buffer) {
+	assert(buffer != NULL);
+
+	bool found = false;
+	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
+		if (swapchain->slots[i].buffer == buffer) {
+			found = true;
+			break;
+		}
+	}
+	if (!found) {
+		return;
+	}
+
+	// The submitted buffer now holds the latest contents, every other
+	// buffer is one frame older
+	for (size_t i = 0; i < WLR_SWAPCHAIN_CAP; i++) {
+		struct wlr_swapchain_slot *slot = &swapchain->slots[i];
+		if (slot->buffer == buffer) {
+			slot->age = 1;
+		} else if (slot->age > 0) {
+			slot->age++;
+		}
+	}
+}
@@ -176,11 +176,107 @@ bool wlr_renderer_read_pixels(struct wlr_renderer *r, enum wl_shm_format fmt,
 		src_x, src_y, dst_x, dst_y, data);
 }
 
+struct wlr_renderer_readback *wlr_renderer_read_pixels_async(
+		struct wlr_renderer *r, enum wl_shm_format fmt, uint32_t width,
+		uint32_t height, uint32_t src_x, uint32_t src_y) {
+	if (!r->impl->read_pixels_async) {
+		return NULL;
+	}
+	return r->impl->read_pixels_async(r, fmt, width, height, src_x, src_y);
+}
+
+void wlr_renderer_readback_init(struct wlr_renderer_readback *readback,
+		const struct wlr_renderer_readback_impl *impl, enum wl_shm_format fmt,
+		uint32_t width, uint32_t height) {
+	assert(impl->is_done);
+	assert(impl->copy);
+	assert(impl->destroy);
+	readback->impl = impl;
+	readback->format = fmt;
+	readback->width = width;
+	readback->height = height;
+}
+
+bool wlr_renderer_readback_is_done(struct wlr_renderer_readback *readback) {
+	return readback->impl->is_done(readback);
+}
+
+int wlr_renderer_readback_get_fence_fd(struct wlr_renderer_readback *readback) {
+	if (!readback->impl->get_fence_fd) {
+		return -1;
+	}
+	return readback->impl->get_fence_fd(readback);
+}
+
+bool wlr_renderer_readback_copy(struct wlr_renderer_readback *readback,
+		uint32_t stride, uint32_t width, uint32_t height, uint32_t src_x,
+		uint32_t src_y, uint32_t dst_x, uint32_t dst_y, void *data) {
+	if (src_x + width > readback->width ||
+			src_y + height > readback->height) {
+		return false;
+	}
+	return readback->impl->copy(readback, stride, width, height,
+		src_x, src_y, dst_x, dst_y, data);
+}
+
+void wlr_renderer_readback_destroy(struct wlr_renderer_readback *readback) {
+	if (readback == NULL) {
+		return;
+	}
+	readback->impl->destroy(readback);
+}
+
 bool wlr_renderer_blit_dmabuf(struct wlr_renderer *r,
 		struct wlr_dmabuf_attributes *dst,
 		struct wlr_dmabuf_attributes *src) {
 	assert(!r->rendering);
 	if (!r->impl->blit_dmabuf) {
+		return wlr_renderer_blit_dmabuf_region(r, dst, NULL, src, NULL);
+	}
+	return r->impl->blit_dmabuf(r, dst, src);
+}
+
+static bool dmabuf_box_valid(const struct wlr_box *box,
+		const struct wlr_dmabuf_attributes *attribs) {
+	return box->x >= 0 && box->y >= 0 && box->width > 0 && box->height > 0 &&
+		box->x + box->width <= attribs->width &&
+		box->y + box->height <= attribs->height;
+}
+
+static bool dmabuf_box_is_full(const struct wlr_box *box,
+		const struct wlr_dmabuf_attributes *attribs) {
+	return box->x == 0 && box->y == 0 && box->width == attribs->width &&
+		box->height == attribs->height;
+}
+
+bool wlr_renderer_blit_dmabuf_region(struct wlr_renderer *r,
+		struct wlr_dmabuf_attributes *dst, const struct wlr_box *dst_box,
+		struct wlr_dmabuf_attributes *src, const struct wlr_box *src_box) {
+	assert(!r->rendering);
+	if (!r->impl->blit_dmabuf_region && !r->impl->blit_dmabuf) {
+		return false;
+	}
+
+	struct wlr_box dst_full = { .width = dst->width, .height = dst->height };
+	struct wlr_box src_full = { .width = src->width, .height = src->height };
+	if (dst_box == NULL) {
+		dst_box = &dst_full;
+	}
+	if (src_box == NULL) {
+		src_box = &src_full;
+	}
+	if (!dmabuf_box_valid(dst_box, dst) || !dmabuf_box_valid(src_box, src)) {
+		wlr_log(WLR_ERROR, "Cannot blit DMA-BUF: box out of bounds");
+		return false;
+	}
+
+	if (r->impl->blit_dmabuf_region) {
+		return r->impl->blit_dmabuf_region(r, dst, dst_box, src, src_box);
+	}
+
+	// Renderers without blit_dmabuf_region can only blit whole buffers
+	if (!dmabuf_box_is_full(dst_box, dst) ||
+			!dmabuf_box_is_full(src_box, src)) {
 		return false;
 	}
 	return r->impl->blit_dmabuf(r, dst, src);
@@ -4,6 +4,7 @@
 #include <wlr/types/wlr_buffer.h>
 #include <wlr/types/wlr_linux_dmabuf_v1.h>
 #include <wlr/util/log.h>
+#include "types/wlr_buffer.h"
 #include "util/signal.h"
 
 void wlr_buffer_init(struct wlr_buffer *buffer,
@@ -139,6 +140,13 @@ static const struct wlr_buffer_impl client_buffer_impl = {
 	.get_dmabuf = client_buffer_get_dmabuf,
 };
 
+struct wlr_client_buffer *wlr_client_buffer_get(struct wlr_buffer *buffer) {
+	if (buffer->impl != &client_buffer_impl) {
+		return NULL;
+	}
+	return (struct wlr_client_buffer *)buffer;
+}
+
 static void client_buffer_resource_handle_destroy(struct wl_listener *listener,
 		void *data) {
 	struct wlr_client_buffer *buffer =
@@ -242,6 +250,42 @@ struct wlr_client_buffer *wlr_client_buffer_import(
 	return buffer;
 }
 
+bool client_buffer_upload_shm(struct wlr_client_buffer *buffer,
+		struct wl_resource *resource, pixman_region32_t *damage) {
+	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
+	assert(shm_buf != NULL);
+	int32_t stride = wl_shm_buffer_get_stride(shm_buf);
+
+	wl_shm_buffer_begin_access(shm_buf);
+	void *data = wl_shm_buffer_get_data(shm_buf);
+
+	int n;
+	pixman_box32_t *rects = pixman_region32_rectangles(damage, &n);
+	for (int i = 0; i < n; ++i) {
+		pixman_box32_t *r = &rects[i];
+		if (!wlr_texture_write_pixels(buffer->texture, stride,
+				r->x2 - r->x1, r->y2 - r->y1, r->x1, r->y1,
+				r->x1, r->y1, data)) {
+			wl_shm_buffer_end_access(shm_buf);
+			return false;
+		}
+	}
+
+	wl_shm_buffer_end_access(shm_buf);
+
+	// We have uploaded the data, we don't need to access the wl_buffer
+	// anymore
+	wl_buffer_send_release(resource);
+
+	wl_list_remove(&buffer->resource_destroy.link);
+	wl_resource_add_destroy_listener(resource, &buffer->resource_destroy);
+	buffer->resource_destroy.notify = client_buffer_resource_handle_destroy;
+
+	buffer->resource = resource;
+	buffer->resource_released = true;
+	return true;
+}
+
 struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 		struct wlr_client_buffer *buffer, struct wl_resource *resource,
 		pixman_region32_t *damage) {
@@ -267,7 +311,6 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 		return NULL;
 	}
 
-	int32_t stride = wl_shm_buffer_get_stride(shm_buf);
 	int32_t width = wl_shm_buffer_get_width(shm_buf);
 	int32_t height = wl_shm_buffer_get_height(shm_buf);
 
@@ -277,32 +320,8 @@ struct wlr_client_buffer *wlr_client_buffer_apply_damage(
 		return NULL;
 	}
 
-	wl_shm_buffer_begin_access(shm_buf);
-	void *data = wl_shm_buffer_get_data(shm_buf);
-
-	int n;
-	pixman_box32_t *rects = pixman_region32_rectangles(damage, &n);
-	for (int i = 0; i < n; ++i) {
-		pixman_box32_t *r = &rects[i];
-		if (!wlr_texture_write_pixels(buffer->texture, stride,
-				r->x2 - r->x1, r->y2 - r->y1, r->x1, r->y1,
-				r->x1, r->y1, data)) {
-			wl_shm_buffer_end_access(shm_buf);
-			return NULL;
-		}
+	if (!client_buffer_upload_shm(buffer, resource, damage)) {
+		return NULL;
 	}
-
-	wl_shm_buffer_end_access(shm_buf);
-
-	// We have uploaded the data, we don't need to access the wl_buffer
-	// anymore
-	wl_buffer_send_release(resource);
-
-	wl_list_remove(&buffer->resource_destroy.link);
-	wl_resource_add_destroy_listener(resource, &buffer->resource_destroy);
-	buffer->resource_destroy.notify = client_buffer_resource_handle_destroy;
-
-	buffer->resource = resource;
-	buffer->resource_released = true;
 	return buffer;
 }
@@ -0,0 +1,177 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <time.h>
+#include <wlr/types/wlr_frame_throttle.h>
+#include <wlr/types/wlr_surface.h>
+#include "util/signal.h"
+#include "util/time.h"
+
+#define DEFAULT_HIDDEN_INTERVAL 1000 // ms
+
+static struct wlr_frame_throttle_surface *throttle_surface_find(
+		struct wlr_frame_throttle *throttle, struct wlr_surface *surface) {
+	struct wlr_frame_throttle_surface *throttle_surface;
+	wl_list_for_each(throttle_surface, &throttle->surfaces, link) {
+		if (throttle_surface->surface == surface) {
+			return throttle_surface;
+		}
+	}
+	return NULL;
+}
+
+static void throttle_surface_destroy(
+		struct wlr_frame_throttle_surface *throttle_surface) {
+	wl_list_remove(&throttle_surface->link);
+	wl_list_remove(&throttle_surface->surface_destroy.link);
+	free(throttle_surface);
+}
+
+static void throttle_surface_handle_surface_destroy(
+		struct wl_listener *listener, void *data) {
+	struct wlr_frame_throttle_surface *throttle_surface =
+		wl_container_of(listener, throttle_surface, surface_destroy);
+	throttle_surface_destroy(throttle_surface);
+}
+
+static bool throttle_surface_due(
+		struct wlr_frame_throttle_surface *throttle_surface,
+		const struct timespec *now) {
+	struct wlr_frame_throttle *throttle = throttle_surface->throttle;
+	if (throttle->hidden_interval <= 0) {
+		return false;
+	}
+
+	struct timespec elapsed;
+	timespec_sub(&elapsed, now, &throttle_surface->last_done);
+	return timespec_to_msec(&elapsed) >= throttle->hidden_interval;
+}
+
+static void throttle_surface_send_frame_done(
+		struct wlr_frame_throttle_surface *throttle_surface,
+		const struct timespec *when) {
+	wlr_surface_send_frame_done(throttle_surface->surface, when);
+	throttle_surface->last_done = *when;
+}
+
+static void throttle_schedule(struct wlr_frame_throttle *throttle) {
+	if (throttle->hidden_interval <= 0 || wl_list_empty(&throttle->surfaces)) {
+		return;
+	}
+	wl_event_source_timer_update(throttle->timer, throttle->hidden_interval);
+}
+
+static int throttle_handle_timer(void *data) {
+	struct wlr_frame_throttle *throttle = data;
+
+	// Hidden surfaces may not be part of any repainted output anymore, so
+	// nothing else would send their frame callbacks
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	struct wlr_frame_throttle_surface *throttle_surface;
+	wl_list_for_each(throttle_surface, &throttle->surfaces, link) {
+		if (throttle_surface_due(throttle_surface, &now)) {
+			throttle_surface_send_frame_done(throttle_surface, &now);
+		}
+	}
+
+	throttle_schedule(throttle);
+	return 0;
+}
+
+static void handle_display_destroy(struct wl_listener *listener, void *data) {
+	struct wlr_frame_throttle *throttle =
+		wl_container_of(listener, throttle, display_destroy);
+	wlr_signal_emit_safe(&throttle->events.destroy, throttle);
+
+	struct wlr_frame_throttle_surface *throttle_surface, *tmp;
+	wl_list_for_each_safe(throttle_surface, tmp, &throttle->surfaces, link) {
+		throttle_surface_destroy(throttle_surface);
+	}
+
+	wl_event_source_remove(throttle->timer);
+	wl_list_remove(&throttle->display_destroy.link);
+	free(throttle);
+}
+
+struct wlr_frame_throttle *wlr_frame_throttle_create(
+		struct wl_display *display) {
+	struct wlr_frame_throttle *throttle =
+		calloc(1, sizeof(struct wlr_frame_throttle));
+	if (throttle == NULL) {
+		return NULL;
+	}
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(display);
+	throttle->timer = wl_event_loop_add_timer(loop, throttle_handle_timer,
+		throttle);
+	if (throttle->timer == NULL) {
+		free(throttle);
+		return NULL;
+	}
+
+	throttle->hidden_interval = DEFAULT_HIDDEN_INTERVAL;
+	wl_list_init(&throttle->surfaces);
+	wl_signal_init(&throttle->events.destroy);
+
+	throttle->display_destroy.notify = handle_display_destroy;
+	wl_display_add_destroy_listener(display, &throttle->display_destroy);
+
+	return throttle;
+}
+
+void wlr_frame_throttle_set_visible(struct wlr_frame_throttle *throttle,
+		struct wlr_surface *surface, bool visible) {
+	struct wlr_frame_throttle_surface *throttle_surface =
+		throttle_surface_find(throttle, surface);
+
+	if (visible) {
+		if (throttle_surface == NULL) {
+			return;
+		}
+
+		// Let the client catch up right away
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		wlr_surface_send_frame_done(surface, &now);
+		throttle_surface_destroy(throttle_surface);
+		return;
+	}
+
+	if (throttle_surface != NULL) {
+		return;
+	}
+
+	throttle_surface = calloc(1, sizeof(struct wlr_frame_throttle_surface));
+	if (throttle_surface == NULL) {
+		return;
+	}
+	throttle_surface->throttle = throttle;
+	throttle_surface->surface = surface;
+	// The surface was visible until now, its callbacks are up to date
+	clock_gettime(CLOCK_MONOTONIC, &throttle_surface->last_done);
+
+	throttle_surface->surface_destroy.notify =
+		throttle_surface_handle_surface_destroy;
+	wl_signal_add(&surface->events.destroy, &throttle_surface->surface_destroy);
+
+	bool was_empty = wl_list_empty(&throttle->surfaces);
+	wl_list_insert(&throttle->surfaces, &throttle_surface->link);
+	if (was_empty) {
+		throttle_schedule(throttle);
+	}
+}
+
+void wlr_frame_throttle_send_frame_done(struct wlr_frame_throttle *throttle,
+		struct wlr_surface *surface, const struct timespec *when) {
+	struct wlr_frame_throttle_surface *throttle_surface =
+		throttle_surface_find(throttle, surface);
+	if (throttle_surface == NULL) {
+		wlr_surface_send_frame_done(surface, when);
+		return;
+	}
+
+	if (throttle_surface_due(throttle_surface, when)) {
+		throttle_surface_send_frame_done(throttle_surface, when);
+	}
+}
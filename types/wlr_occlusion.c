@@ -0,0 +1,109 @@
+#include <math.h>
+#include <stdlib.h>
+#include <wlr/types/wlr_occlusion.h>
+#include <wlr/types/wlr_output.h>
+#include <wlr/types/wlr_surface.h>
+#include <wlr/util/region.h>
+
+/**
+ * Converts a region from output-local layout coordinates to output buffer
+ * coordinates. Boxes are rounded outwards, or inwards if `shrink` is set, so
+ * that partially covered pixels never count as opaque.
+ */
+static void region_to_buffer(pixman_region32_t *region,
+		struct wlr_output *output, bool shrink) {
+	if (output == NULL) {
+		return;
+	}
+
+	int width, height;
+	wlr_output_effective_resolution(output, &width, &height);
+	enum wl_output_transform transform =
+		wlr_output_transform_invert(output->transform);
+	wlr_region_transform(region, region, transform, width, height);
+
+	float scale = output->scale;
+	if (scale == 1.0) {
+		return;
+	}
+	if (!shrink) {
+		wlr_region_scale(region, region, scale);
+		return;
+	}
+
+	int nrects;
+	pixman_box32_t *src_rects = pixman_region32_rectangles(region, &nrects);
+	pixman_box32_t *dst_rects = malloc(nrects * sizeof(pixman_box32_t));
+	if (dst_rects == NULL) {
+		pixman_region32_clear(region);
+		return;
+	}
+
+	int n = 0;
+	for (int i = 0; i < nrects; ++i) {
+		pixman_box32_t box = {
+			.x1 = ceil(src_rects[i].x1 * scale),
+			.y1 = ceil(src_rects[i].y1 * scale),
+			.x2 = floor(src_rects[i].x2 * scale),
+			.y2 = floor(src_rects[i].y2 * scale),
+		};
+		if (box.x1 < box.x2 && box.y1 < box.y2) {
+			dst_rects[n++] = box;
+		}
+	}
+
+	pixman_region32_fini(region);
+	pixman_region32_init_rects(region, dst_rects, n);
+	free(dst_rects);
+}
+
+size_t wlr_occlusion_compute(struct wlr_output *output,
+		struct wlr_occlusion_surface *surfaces, size_t surfaces_len,
+		pixman_region32_t *damage, pixman_region32_t *uncovered) {
+	// Part of the damage not hidden by the surfaces walked so far
+	pixman_region32_t remaining;
+	pixman_region32_init(&remaining);
+	pixman_region32_copy(&remaining, damage);
+
+	pixman_region32_t region;
+	pixman_region32_init(&region);
+
+	size_t visible_len = 0;
+	for (size_t i = surfaces_len; i-- > 0;) {
+		struct wlr_occlusion_surface *entry = &surfaces[i];
+		struct wlr_surface *surface = entry->surface;
+
+		if (!pixman_region32_not_empty(&remaining) ||
+				!wlr_surface_has_buffer(surface)) {
+			pixman_region32_clear(&entry->visible);
+			continue;
+		}
+
+		pixman_region32_fini(&region);
+		pixman_region32_init_rect(&region, entry->x, entry->y,
+			surface->current.width, surface->current.height);
+		region_to_buffer(&region, output, false);
+		pixman_region32_intersect(&entry->visible, &remaining, &region);
+		if (!pixman_region32_not_empty(&entry->visible)) {
+			continue;
+		}
+		visible_len++;
+
+		if (entry->translucent) {
+			continue;
+		}
+
+		pixman_region32_copy(&region, &surface->opaque_region);
+		pixman_region32_translate(&region, entry->x, entry->y);
+		region_to_buffer(&region, output, true);
+		pixman_region32_subtract(&remaining, &remaining, &region);
+	}
+
+	if (uncovered != NULL) {
+		pixman_region32_copy(uncovered, &remaining);
+	}
+
+	pixman_region32_fini(&region);
+	pixman_region32_fini(&remaining);
+	return visible_len;
+}
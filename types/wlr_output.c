@@ -752,6 +752,13 @@ size_t wlr_output_get_gamma_size(struct wlr_output *output) {
 	return output->impl->get_gamma_size(output);
 }
 
+size_t wlr_output_get_swapchain_len(struct wlr_output *output) {
+	if (!output->impl->get_swapchain_len) {
+		return 0;
+	}
+	return output->impl->get_swapchain_len(output);
+}
+
 bool wlr_output_export_dmabuf(struct wlr_output *output,
 		struct wlr_dmabuf_attributes *attribs) {
 	if (!output->impl->export_dmabuf) {
@@ -6,6 +6,7 @@
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/box.h>
 #include <wlr/util/log.h>
+#include <wlr/util/region.h>
 #include "util/signal.h"
 
 static void output_handle_destroy(struct wl_listener *listener, void *data) {
@@ -71,8 +72,8 @@ static void output_handle_commit(struct wl_listener *listener, void *data) {
 		// render-buffers have been swapped, rotate the damage
 
 		// same as decrementing, but works on unsigned integers
-		output_damage->previous_idx += WLR_OUTPUT_DAMAGE_PREVIOUS_LEN - 1;
-		output_damage->previous_idx %= WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+		output_damage->previous_idx += output_damage->previous_len - 1;
+		output_damage->previous_idx %= output_damage->previous_len;
 
 		prev = &output_damage->previous[output_damage->previous_idx];
 		pixman_region32_copy(prev, &output_damage->current);
@@ -88,19 +89,43 @@ static void output_handle_commit(struct wl_listener *listener, void *data) {
 }
 
 struct wlr_output_damage *wlr_output_damage_create(struct wlr_output *output) {
+	// A buffer can't be older than the swapchain length, so the damage of
+	// all the other buffers of the swapchain needs to be kept
+	size_t previous_len = WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+	size_t swapchain_len = wlr_output_get_swapchain_len(output);
+	if (swapchain_len > 1) {
+		previous_len = swapchain_len - 1;
+	}
+	return wlr_output_damage_create_with_len(output, previous_len);
+}
+
+struct wlr_output_damage *wlr_output_damage_create_with_len(
+		struct wlr_output *output, size_t previous_len) {
+	if (previous_len == 0) {
+		previous_len = 1;
+	}
+
 	struct wlr_output_damage *output_damage =
 		calloc(1, sizeof(struct wlr_output_damage));
 	if (output_damage == NULL) {
 		return NULL;
 	}
 
+	output_damage->previous = calloc(previous_len, sizeof(pixman_region32_t));
+	if (output_damage->previous == NULL) {
+		free(output_damage);
+		return NULL;
+	}
+	output_damage->previous_len = previous_len;
+
 	output_damage->output = output;
 	output_damage->max_rects = 20;
+	output_damage->rect_cost = 0;
 	wl_signal_init(&output_damage->events.frame);
 	wl_signal_init(&output_damage->events.destroy);
 
 	pixman_region32_init(&output_damage->current);
-	for (size_t i = 0; i < WLR_OUTPUT_DAMAGE_PREVIOUS_LEN; ++i) {
+	for (size_t i = 0; i < output_damage->previous_len; ++i) {
 		pixman_region32_init(&output_damage->previous[i]);
 	}
 
@@ -138,9 +163,10 @@ void wlr_output_damage_destroy(struct wlr_output_damage *output_damage) {
 	wl_list_remove(&output_damage->output_frame.link);
 	wl_list_remove(&output_damage->output_commit.link);
 	pixman_region32_fini(&output_damage->current);
-	for (size_t i = 0; i < WLR_OUTPUT_DAMAGE_PREVIOUS_LEN; ++i) {
+	for (size_t i = 0; i < output_damage->previous_len; ++i) {
 		pixman_region32_fini(&output_damage->previous[i]);
 	}
+	free(output_damage->previous);
 	free(output_damage);
 }
 
@@ -156,24 +182,36 @@ bool wlr_output_damage_attach_render(struct wlr_output_damage *output_damage,
 	*needs_frame =
 		output->needs_frame || pixman_region32_not_empty(&output_damage->current);
 	// Check if we can use damage tracking
-	if (buffer_age <= 0 || buffer_age - 1 > WLR_OUTPUT_DAMAGE_PREVIOUS_LEN) {
+	if (buffer_age <= 0 ||
+			(size_t)buffer_age - 1 > output_damage->previous_len) {
 		int width, height;
 		wlr_output_transformed_resolution(output, &width, &height);
 
 		// Buffer new or too old, damage the whole output
 		pixman_region32_union_rect(damage, damage, 0, 0, width, height);
 		*needs_frame = true;
+
+		output_damage->stats.damaged_pixels = wlr_region_area(damage);
 	} else {
 		pixman_region32_copy(damage, &output_damage->current);
 
 		// Accumulate damage from old buffers
 		size_t idx = output_damage->previous_idx;
 		for (int i = 0; i < buffer_age - 1; ++i) {
-			int j = (idx + i) % WLR_OUTPUT_DAMAGE_PREVIOUS_LEN;
+			int j = (idx + i) % output_damage->previous_len;
 			pixman_region32_union(damage, damage, &output_damage->previous[j]);
 		}
 
-		// Check the number of rectangles
+		output_damage->stats.damaged_pixels = wlr_region_area(damage);
+
+		// Trade a few repainted pixels for fewer rectangles
+		if (output_damage->rect_cost > 0) {
+			wlr_region_simplify(damage, damage, output_damage->max_rects,
+				output_damage->rect_cost);
+		}
+
+		// Merged rectangles may still overlap in a way that needs more
+		// rectangles than allowed
 		int n_rects = pixman_region32_n_rects(damage);
 		if (n_rects > output_damage->max_rects) {
 			pixman_box32_t *extents = pixman_region32_extents(damage);
@@ -182,6 +220,9 @@ bool wlr_output_damage_attach_render(struct wlr_output_damage *output_damage,
 		}
 	}
 
+	output_damage->stats.rects = pixman_region32_n_rects(damage);
+	output_damage->stats.repainted_pixels = wlr_region_area(damage);
+
 	// HACK: this should really be done by the compositor rather than us
 	if (!wlr_output_handle_damage(output, damage)) {
 		wlr_log(WLR_ERROR, "Error during handle_damage call");
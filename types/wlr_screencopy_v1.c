@@ -1,5 +1,7 @@
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 #include <drm_fourcc.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_output.h>
@@ -22,8 +24,62 @@ struct screencopy_damage {
 	uint32_t last_commit_seq;
 };
 
+struct screencopy_readback_frame {
+	struct wlr_screencopy_frame_v1 *frame;
+	pixman_region32_t region; // part of the output buffer to copy
+	struct wl_list link; // screencopy_readback::frames
+};
+
+/**
+ * A read-back of the output buffer shared by all the shm frames capturing
+ * the same output commit. The extents of the regions the frames need are
+ * read back at once, and each frame's buffer is then filled with its own
+ * part.
+ */
+struct screencopy_readback {
+	enum wl_shm_format format;
+	int bpp; // bytes per pixel
+	struct timespec when;
+	struct wlr_box box; // part of the output buffer read back
+
+	// Asynchronous read-back
+	struct wlr_renderer_readback *readback;
+	int fence_fd; // -1 once signalled or if unavailable
+	struct wl_event_source *fence_source;
+	// Polls the asynchronous read-back once per output refresh, for
+	// renderers which can't export a fence FD
+	struct wl_event_source *timer;
+	int poll_interval; // ms
+
+	// Fallback for renderers without asynchronous read-back
+	unsigned char *staging;
+	uint32_t staging_stride;
+	bool y_invert;
+
+	struct wl_list frames; // screencopy_readback_frame::link
+};
+
+struct screencopy_frame {
+	struct wlr_screencopy_frame_v1 base;
+
+	// Pending read-back shared by all shm frames capturing the same output
+	// commit
+	struct screencopy_readback *readback;
+};
+
 static const struct zwlr_screencopy_frame_v1_interface frame_impl;
 
+static struct screencopy_frame *screencopy_frame_from_frame(
+		struct wlr_screencopy_frame_v1 *frame) {
+	struct screencopy_frame *screencopy_frame =
+		wl_container_of(frame, screencopy_frame, base);
+	return screencopy_frame;
+}
+
+static void screencopy_readback_remove_frame(
+	struct screencopy_readback *readback,
+	struct wlr_screencopy_frame_v1 *frame);
+
 static struct screencopy_damage *screencopy_damage_find(
 		struct wlr_screencopy_v1_client *client,
 		struct wlr_output *output) {
@@ -148,6 +204,11 @@ static void frame_destroy(struct wlr_screencopy_frame_v1 *frame) {
 	wl_list_remove(&frame->output_destroy.link);
 	wl_list_remove(&frame->output_enable.link);
 	wl_list_remove(&frame->buffer_destroy.link);
+	struct screencopy_frame *screencopy_frame =
+		screencopy_frame_from_frame(frame);
+	if (screencopy_frame->readback != NULL) {
+		screencopy_readback_remove_frame(screencopy_frame->readback, frame);
+	}
 	// Make the frame resource inert
 	wl_resource_set_user_data(frame->resource, NULL);
 	client_unref(frame->client);
@@ -189,6 +250,284 @@ static void frame_send_ready(struct wlr_screencopy_frame_v1 *frame,
 		tv_sec_hi, tv_sec_lo, when->tv_nsec);
 }
 
+static bool frame_shm_copy_pending(struct wlr_screencopy_frame_v1 *frame) {
+	if (!frame->with_damage) {
+		return true;
+	}
+
+	struct screencopy_damage *damage =
+		screencopy_damage_get_or_create(frame->client, frame->output);
+	if (damage) {
+		screencopy_damage_accumulate(damage);
+		return pixman_region32_not_empty(&damage->damage);
+	}
+	return true;
+}
+
+static bool readback_copy_box(struct screencopy_readback *readback,
+		const pixman_box32_t *box, struct wlr_screencopy_frame_v1 *frame,
+		unsigned char *data, int32_t stride) {
+	uint32_t width = box->x2 - box->x1;
+	uint32_t height = box->y2 - box->y1;
+	uint32_t src_x = box->x1 - readback->box.x;
+	uint32_t src_y = box->y1 - readback->box.y;
+	uint32_t dst_x = box->x1 - frame->box.x;
+	uint32_t dst_y = box->y1 - frame->box.y;
+
+	if (readback->readback != NULL) {
+		return wlr_renderer_readback_copy(readback->readback, stride,
+			width, height, src_x, src_y, dst_x, dst_y, data);
+	}
+
+	unsigned char *dst = data + dst_y * stride + dst_x * readback->bpp;
+	const unsigned char *src = readback->staging + src_x * readback->bpp;
+	size_t row_size = width * readback->bpp;
+	for (uint32_t i = 0; i < height; ++i) {
+		uint32_t row = src_y + i;
+		if (readback->y_invert) {
+			row = readback->box.height - row - 1;
+		}
+		memcpy(dst + i * stride, src + row * readback->staging_stride,
+			row_size);
+	}
+	return true;
+}
+
+static bool frame_copy_from_readback(struct screencopy_readback *readback,
+		struct screencopy_readback_frame *readback_frame) {
+	struct wlr_screencopy_frame_v1 *frame = readback_frame->frame;
+	struct wl_shm_buffer *shm_buffer = frame->shm_buffer;
+	int32_t stride = wl_shm_buffer_get_stride(shm_buffer);
+
+	wl_shm_buffer_begin_access(shm_buffer);
+	unsigned char *data = wl_shm_buffer_get_data(shm_buffer);
+	int nrects;
+	pixman_box32_t *boxes =
+		pixman_region32_rectangles(&readback_frame->region, &nrects);
+	bool ok = true;
+	for (int i = 0; ok && i < nrects; i++) {
+		ok = readback_copy_box(readback, &boxes[i], frame, data, stride);
+	}
+	wl_shm_buffer_end_access(shm_buffer);
+
+	return ok;
+}
+
+static void readback_frame_destroy(
+		struct screencopy_readback_frame *readback_frame) {
+	screencopy_frame_from_frame(readback_frame->frame)->readback = NULL;
+	wl_list_remove(&readback_frame->link);
+	pixman_region32_fini(&readback_frame->region);
+	free(readback_frame);
+}
+
+static void readback_finish_fence(struct screencopy_readback *readback) {
+	if (readback->fence_source != NULL) {
+		wl_event_source_remove(readback->fence_source);
+		readback->fence_source = NULL;
+	}
+	if (readback->fence_fd >= 0) {
+		close(readback->fence_fd);
+		readback->fence_fd = -1;
+	}
+}
+
+static void screencopy_readback_destroy(struct screencopy_readback *readback) {
+	struct screencopy_readback_frame *readback_frame, *tmp;
+	wl_list_for_each_safe(readback_frame, tmp, &readback->frames, link) {
+		readback_frame_destroy(readback_frame);
+	}
+	if (readback->timer != NULL) {
+		wl_event_source_remove(readback->timer);
+	}
+	readback_finish_fence(readback);
+	wlr_renderer_readback_destroy(readback->readback);
+	free(readback->staging);
+	free(readback);
+}
+
+static void screencopy_readback_remove_frame(
+		struct screencopy_readback *readback,
+		struct wlr_screencopy_frame_v1 *frame) {
+	struct screencopy_readback_frame *readback_frame;
+	wl_list_for_each(readback_frame, &readback->frames, link) {
+		if (readback_frame->frame == frame) {
+			readback_frame_destroy(readback_frame);
+			break;
+		}
+	}
+	if (wl_list_empty(&readback->frames)) {
+		screencopy_readback_destroy(readback);
+	}
+}
+
+static void screencopy_readback_finish(struct screencopy_readback *readback,
+		bool ok) {
+	struct screencopy_readback_frame *readback_frame, *tmp;
+	wl_list_for_each_safe(readback_frame, tmp, &readback->frames, link) {
+		struct wlr_screencopy_frame_v1 *frame = readback_frame->frame;
+		bool frame_ok = ok && frame_copy_from_readback(readback, readback_frame);
+		readback_frame_destroy(readback_frame);
+
+		if (!frame_ok) {
+			zwlr_screencopy_frame_v1_send_failed(frame->resource);
+			frame_destroy(frame);
+			continue;
+		}
+
+		// Rows are always copied top to bottom
+		zwlr_screencopy_frame_v1_send_flags(frame->resource, 0);
+		frame_send_ready(frame, &readback->when);
+		frame_destroy(frame);
+	}
+
+	screencopy_readback_destroy(readback);
+}
+
+static void screencopy_readback_check_done(
+		struct screencopy_readback *readback) {
+	if (readback->fence_fd >= 0) {
+		// Woken up again once the fence signals
+		return;
+	}
+
+	if (!wlr_renderer_readback_is_done(readback->readback)) {
+		wl_event_source_timer_update(readback->timer,
+			readback->poll_interval);
+		return;
+	}
+
+	screencopy_readback_finish(readback, true);
+}
+
+static int screencopy_readback_handle_timer(void *data) {
+	struct screencopy_readback *readback = data;
+	screencopy_readback_check_done(readback);
+	return 0;
+}
+
+static int screencopy_readback_handle_fence(int fd, uint32_t mask,
+		void *data) {
+	struct screencopy_readback *readback = data;
+
+	// A signalled sync_file stays readable: stop watching it
+	readback_finish_fence(readback);
+
+	screencopy_readback_check_done(readback);
+	return 0;
+}
+
+static bool screencopy_readback_start_async(
+		struct screencopy_readback *readback, struct wlr_output *output,
+		struct wlr_renderer *renderer) {
+	readback->readback = wlr_renderer_read_pixels_async(renderer,
+		readback->format, readback->box.width, readback->box.height,
+		readback->box.x, readback->box.y);
+	if (readback->readback == NULL) {
+		return false;
+	}
+
+	struct wl_event_loop *loop = wl_display_get_event_loop(output->display);
+	readback->fence_fd =
+		wlr_renderer_readback_get_fence_fd(readback->readback);
+	if (readback->fence_fd >= 0) {
+		readback->fence_source = wl_event_loop_add_fd(loop,
+			readback->fence_fd, WL_EVENT_READABLE,
+			screencopy_readback_handle_fence, readback);
+		if (readback->fence_source != NULL) {
+			return true;
+		}
+		close(readback->fence_fd);
+		readback->fence_fd = -1;
+	}
+
+	// Without a fence FD, check once per refresh whether the GPU is done
+	int refresh = output->refresh > 0 ? output->refresh : 60000; // mHz
+	readback->poll_interval = 1000000 / refresh;
+	if (readback->poll_interval < 1) {
+		readback->poll_interval = 1;
+	}
+	readback->timer = wl_event_loop_add_timer(loop,
+		screencopy_readback_handle_timer, readback);
+	if (readback->timer == NULL) {
+		wlr_renderer_readback_destroy(readback->readback);
+		readback->readback = NULL;
+		return false;
+	}
+	wl_event_source_timer_update(readback->timer, readback->poll_interval);
+	return true;
+}
+
+static bool screencopy_readback_read_sync(
+		struct screencopy_readback *readback,
+		struct wlr_renderer *renderer) {
+	readback->staging_stride = readback->box.width * readback->bpp;
+	readback->staging =
+		malloc((size_t)readback->staging_stride * readback->box.height);
+	if (readback->staging == NULL) {
+		wlr_log(WLR_ERROR, "Allocation failed");
+		return false;
+	}
+
+	uint32_t renderer_flags = 0;
+	if (!wlr_renderer_read_pixels(renderer, readback->format,
+			&renderer_flags, readback->staging_stride, readback->box.width,
+			readback->box.height, readback->box.x, readback->box.y, 0, 0,
+			readback->staging)) {
+		return false;
+	}
+	readback->y_invert = renderer_flags & WLR_RENDERER_READ_PIXELS_Y_INVERT;
+	return true;
+}
+
+static bool screencopy_readback_add_frame(
+		struct screencopy_readback *readback,
+		struct wlr_screencopy_frame_v1 *frame) {
+	struct screencopy_readback_frame *readback_frame =
+		calloc(1, sizeof(struct screencopy_readback_frame));
+	if (readback_frame == NULL) {
+		return false;
+	}
+	readback_frame->frame = frame;
+	pixman_region32_init_rect(&readback_frame->region, frame->box.x,
+		frame->box.y, frame->box.width, frame->box.height);
+
+	// With copy_with_damage, the client buffer already holds the previous
+	// frame: only the damaged part needs to be read back
+	if (frame->with_damage) {
+		struct screencopy_damage *damage =
+			screencopy_damage_find(frame->client, frame->output);
+		if (damage != NULL) {
+			pixman_region32_intersect(&readback_frame->region,
+				&readback_frame->region, &damage->damage);
+		}
+	}
+
+	screencopy_frame_from_frame(frame)->readback = readback;
+	wl_list_insert(&readback->frames, &readback_frame->link);
+	return true;
+}
+
+static void screencopy_readback_init_box(
+		struct screencopy_readback *readback) {
+	pixman_region32_t region;
+	pixman_region32_init(&region);
+	struct screencopy_readback_frame *readback_frame;
+	wl_list_for_each(readback_frame, &readback->frames, link) {
+		pixman_region32_union(&region, &region, &readback_frame->region);
+	}
+
+	pixman_box32_t *extents = pixman_region32_extents(&region);
+	readback->box = (struct wlr_box){
+		.x = extents->x1,
+		.y = extents->y1,
+		.width = extents->x2 - extents->x1,
+		.height = extents->y2 - extents->y1,
+	};
+
+	pixman_region32_fini(&region);
+}
+
 static void frame_handle_output_precommit(struct wl_listener *listener,
 		void *_data) {
 	struct wlr_screencopy_frame_v1 *frame =
@@ -202,52 +541,61 @@ static void frame_handle_output_precommit(struct wl_listener *listener,
 		return;
 	}
 
-	struct wl_shm_buffer *shm_buffer = frame->shm_buffer;
-	if (shm_buffer == NULL) {
+	if (frame->shm_buffer == NULL || !frame_shm_copy_pending(frame)) {
 		return;
 	}
 
-	if (frame->with_damage) {
-		struct screencopy_damage *damage =
-			screencopy_damage_get_or_create(frame->client, output);
-		if (damage) {
-			screencopy_damage_accumulate(damage);
-			if (!pixman_region32_not_empty(&damage->damage)) {
-				return;
-			}
-		}
+	struct screencopy_readback *readback =
+		calloc(1, sizeof(struct screencopy_readback));
+	if (readback == NULL) {
+		zwlr_screencopy_frame_v1_send_failed(frame->resource);
+		frame_destroy(frame);
+		return;
 	}
+	wl_list_init(&readback->frames);
+	readback->fence_fd = -1;
+	readback->format = frame->format;
+	readback->bpp = frame->stride / frame->box.width;
+	readback->when = *event->when;
+
+	// Read back what all the shm frames capturing this commit need at once,
+	// instead of stalling on the GPU once per frame
+	struct wlr_screencopy_frame_v1 *other, *tmp;
+	wl_list_for_each_safe(other, tmp, &frame->client->manager->frames, link) {
+		if (other->output != output || other->shm_buffer == NULL ||
+				other->format != frame->format ||
+				wl_list_empty(&other->output_precommit.link) ||
+				!frame_shm_copy_pending(other)) {
+			continue;
+		}
 
-	wl_list_remove(&frame->output_precommit.link);
-	wl_list_init(&frame->output_precommit.link);
+		wl_list_remove(&other->output_precommit.link);
+		wl_list_init(&other->output_precommit.link);
 
-	int x = frame->box.x;
-	int y = frame->box.y;
+		if (!screencopy_readback_add_frame(readback, other)) {
+			zwlr_screencopy_frame_v1_send_failed(other->resource);
+			frame_destroy(other);
+			continue;
+		}
 
-	enum wl_shm_format fmt = wl_shm_buffer_get_format(shm_buffer);
-	int32_t width = wl_shm_buffer_get_width(shm_buffer);
-	int32_t height = wl_shm_buffer_get_height(shm_buffer);
-	int32_t stride = wl_shm_buffer_get_stride(shm_buffer);
+		// Damage must be sent for the contents of this commit
+		frame_send_damage(other);
+	}
 
-	wl_shm_buffer_begin_access(shm_buffer);
-	void *data = wl_shm_buffer_get_data(shm_buffer);
-	uint32_t renderer_flags = 0;
-	bool ok = wlr_renderer_read_pixels(renderer, fmt, &renderer_flags,
-		stride, width, height, x, y, 0, 0, data);
-	uint32_t flags = renderer_flags & WLR_RENDERER_READ_PIXELS_Y_INVERT ?
-		ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
-	wl_shm_buffer_end_access(shm_buffer);
+	screencopy_readback_init_box(readback);
+	if (wlr_box_empty(&readback->box)) {
+		screencopy_readback_finish(readback, true);
+		return;
+	}
 
-	if (!ok) {
-		zwlr_screencopy_frame_v1_send_failed(frame->resource);
-		frame_destroy(frame);
+	// Prefer reading the pixels without stalling the main loop, the frames
+	// are then completed from screencopy_readback_check_done
+	if (screencopy_readback_start_async(readback, output, renderer)) {
 		return;
 	}
 
-	zwlr_screencopy_frame_v1_send_flags(frame->resource, flags);
-	frame_send_damage(frame);
-	frame_send_ready(frame, event->when);
-	frame_destroy(frame);
+	bool ok = screencopy_readback_read_sync(readback, renderer);
+	screencopy_readback_finish(readback, ok);
 }
 
 static void frame_handle_output_commit(struct wl_listener *listener,
@@ -279,19 +627,10 @@ static void frame_handle_output_commit(struct wl_listener *listener,
 	wl_list_remove(&frame->output_commit.link);
 	wl_list_init(&frame->output_commit.link);
 
-	// TODO: add support for copying regions with DMA-BUFs
-	if (frame->box.x != 0 || frame->box.y != 0 ||
-			output->width != frame->box.width ||
-			output->height != frame->box.height) {
-		zwlr_screencopy_frame_v1_send_failed(frame->resource);
-		frame_destroy(frame);
-		return;
-	}
-
 	struct wlr_dmabuf_attributes attr = { 0 };
 	bool ok = wlr_output_export_dmabuf(output, &attr);
-	ok = ok && wlr_renderer_blit_dmabuf(renderer,
-		&dma_buffer->attributes, &attr);
+	ok = ok && wlr_renderer_blit_dmabuf_region(renderer,
+		&dma_buffer->attributes, NULL, &attr, &frame->box);
 	uint32_t flags = dma_buffer->attributes.flags & WLR_DMABUF_ATTRIBUTES_FLAGS_Y_INVERT ?
 		ZWLR_SCREENCOPY_FRAME_V1_FLAGS_Y_INVERT : 0;
 	wlr_dmabuf_attributes_finish(&attr);
@@ -499,12 +838,13 @@ static void capture_output(struct wl_client *wl_client,
 		struct wlr_screencopy_v1_client *client, uint32_t version,
 		uint32_t id, int32_t overlay_cursor, struct wlr_output *output,
 		const struct wlr_box *box) {
-	struct wlr_screencopy_frame_v1 *frame =
-		calloc(1, sizeof(struct wlr_screencopy_frame_v1));
-	if (frame == NULL) {
+	struct screencopy_frame *screencopy_frame =
+		calloc(1, sizeof(struct screencopy_frame));
+	if (screencopy_frame == NULL) {
 		wl_client_post_no_memory(wl_client);
 		return;
 	}
+	struct wlr_screencopy_frame_v1 *frame = &screencopy_frame->base;
 	frame->output = output;
 	frame->overlay_cursor = !!overlay_cursor;
 
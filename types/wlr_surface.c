@@ -10,6 +10,7 @@
 #include <wlr/types/wlr_output.h>
 #include <wlr/util/log.h>
 #include <wlr/util/region.h>
+#include "types/wlr_buffer.h"
 #include "util/signal.h"
 #include "util/time.h"
 
@@ -17,6 +18,26 @@
 #define SURFACE_VERSION 4
 #define SUBSURFACE_VERSION 1
 
+// Enough for triple-buffering clients
+#define SHM_CACHE_MAX_LEN 3
+
+struct surface_shm_cache_entry {
+	struct wl_list link; // wlr_surface.shm_cache, most recently used first
+
+	struct wlr_client_buffer *buffer; // locked
+
+	// The region of the wl_shm_pool holding the buffer. The pool is
+	// referenced so that it can't be re-used for another pool. Resizing the
+	// pool can move its mapping, in which case entries just stop matching.
+	struct wl_shm_pool *pool;
+	void *data;
+	int32_t width, height, stride;
+	enum wl_shm_format format;
+
+	// Damage accumulated since the texture was last updated
+	pixman_region32_t damage;
+};
+
 static int min(int fst, int snd) {
 	if (fst < snd) {
 		return fst;
@@ -334,6 +355,132 @@ static void surface_damage_subsurfaces(struct wlr_subsurface *subsurface) {
 	}
 }
 
+static void shm_cache_entry_destroy(struct surface_shm_cache_entry *entry) {
+	wl_list_remove(&entry->link);
+	wlr_buffer_unlock(&entry->buffer->base);
+	wl_shm_pool_unref(entry->pool);
+	pixman_region32_fini(&entry->damage);
+	free(entry);
+}
+
+static void surface_shm_cache_add_damage(struct wlr_surface *surface) {
+	int buffer_width = surface->current.buffer_width;
+	int buffer_height = surface->current.buffer_height;
+	if (buffer_width == 0 && buffer_height == 0) {
+		// NULL commit, the next buffer will be fully damaged
+		return;
+	}
+
+	struct surface_shm_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &surface->shm_cache, link) {
+		if (entry->width != buffer_width || entry->height != buffer_height) {
+			// The damage isn't tracked for buffers of another size
+			shm_cache_entry_destroy(entry);
+			continue;
+		}
+		pixman_region32_union(&entry->damage, &entry->damage,
+			&surface->buffer_damage);
+	}
+}
+
+static bool shm_cache_entry_matches(struct surface_shm_cache_entry *entry,
+		struct wl_shm_pool *pool, struct wl_shm_buffer *shm_buf) {
+	return entry->pool == pool &&
+		entry->data == wl_shm_buffer_get_data(shm_buf) &&
+		entry->width == wl_shm_buffer_get_width(shm_buf) &&
+		entry->height == wl_shm_buffer_get_height(shm_buf) &&
+		entry->stride == wl_shm_buffer_get_stride(shm_buf) &&
+		entry->format == wl_shm_buffer_get_format(shm_buf);
+}
+
+/**
+ * Look for a texture previously uploaded from the same wl_shm_pool region and
+ * bring it up to date. Returns a locked buffer, or NULL if there is none.
+ */
+static struct wlr_client_buffer *surface_shm_cache_apply(
+		struct wlr_surface *surface, struct wl_resource *resource,
+		struct wl_shm_buffer *shm_buf) {
+	struct wl_shm_pool *pool = wl_shm_buffer_ref_pool(shm_buf);
+
+	struct surface_shm_cache_entry *entry = NULL, *iter;
+	wl_list_for_each(iter, &surface->shm_cache, link) {
+		if (shm_cache_entry_matches(iter, pool, shm_buf)) {
+			entry = iter;
+			break;
+		}
+	}
+	wl_shm_pool_unref(pool);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	// The cache and the surface may hold a lock, anyone else is still
+	// reading the texture and it can't be updated
+	size_t n_locks = 1;
+	if (surface->buffer == entry->buffer) {
+		n_locks++;
+	}
+	if (entry->buffer->texture == NULL ||
+			entry->buffer->base.n_locks > n_locks ||
+			!client_buffer_upload_shm(entry->buffer, resource,
+				&entry->damage)) {
+		shm_cache_entry_destroy(entry);
+		return NULL;
+	}
+
+	pixman_region32_clear(&entry->damage);
+	wl_list_remove(&entry->link);
+	wl_list_insert(&surface->shm_cache, &entry->link);
+
+	wlr_buffer_lock(&entry->buffer->base);
+	return entry->buffer;
+}
+
+static void surface_shm_cache_insert(struct wlr_surface *surface,
+		struct wlr_client_buffer *buffer, struct wl_shm_buffer *shm_buf) {
+	struct surface_shm_cache_entry *entry = calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		return;
+	}
+	entry->buffer = buffer;
+	wlr_buffer_lock(&buffer->base);
+	entry->pool = wl_shm_buffer_ref_pool(shm_buf);
+	entry->data = wl_shm_buffer_get_data(shm_buf);
+	entry->width = wl_shm_buffer_get_width(shm_buf);
+	entry->height = wl_shm_buffer_get_height(shm_buf);
+	entry->stride = wl_shm_buffer_get_stride(shm_buf);
+	entry->format = wl_shm_buffer_get_format(shm_buf);
+	pixman_region32_init(&entry->damage);
+	wl_list_insert(&surface->shm_cache, &entry->link);
+
+	if (wl_list_length(&surface->shm_cache) > SHM_CACHE_MAX_LEN) {
+		struct surface_shm_cache_entry *last =
+			wl_container_of(surface->shm_cache.prev, last, link);
+		shm_cache_entry_destroy(last);
+	}
+}
+
+/**
+ * Drop the cache entry holding the buffer, if any, along with its lock.
+ */
+static void surface_shm_cache_remove(struct wlr_surface *surface,
+		struct wlr_client_buffer *buffer) {
+	struct surface_shm_cache_entry *entry;
+	wl_list_for_each(entry, &surface->shm_cache, link) {
+		if (entry->buffer == buffer) {
+			shm_cache_entry_destroy(entry);
+			return;
+		}
+	}
+}
+
+static void surface_shm_cache_finish(struct wlr_surface *surface) {
+	struct surface_shm_cache_entry *entry, *tmp;
+	wl_list_for_each_safe(entry, tmp, &surface->shm_cache, link) {
+		shm_cache_entry_destroy(entry);
+	}
+}
+
 static void surface_apply_damage(struct wlr_surface *surface) {
 	struct wl_resource *resource = surface->current.buffer_resource;
 	if (resource == NULL) {
@@ -345,12 +492,32 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 		return;
 	}
 
+	struct wl_shm_buffer *shm_buf = wl_shm_buffer_get(resource);
+	if (shm_buf != NULL) {
+		struct wlr_client_buffer *cached_buffer =
+			surface_shm_cache_apply(surface, resource, shm_buf);
+		if (cached_buffer != NULL) {
+			if (surface->buffer != NULL) {
+				wlr_buffer_unlock(&surface->buffer->base);
+			}
+			surface->buffer = cached_buffer;
+			return;
+		}
+	}
+
 	if (surface->buffer != NULL && surface->buffer->resource_released) {
+		// The current buffer gets overwritten, its cache entry would go
+		// stale and its lock would prevent the update
+		surface_shm_cache_remove(surface, surface->buffer);
+
 		struct wlr_client_buffer *updated_buffer =
 			wlr_client_buffer_apply_damage(surface->buffer, resource,
 			&surface->buffer_damage);
 		if (updated_buffer != NULL) {
 			surface->buffer = updated_buffer;
+			if (shm_buf != NULL) {
+				surface_shm_cache_insert(surface, updated_buffer, shm_buf);
+			}
 			return;
 		}
 	}
@@ -366,6 +533,9 @@ static void surface_apply_damage(struct wlr_surface *surface) {
 		wlr_buffer_unlock(&surface->buffer->base);
 	}
 	surface->buffer = buffer;
+	if (shm_buf != NULL) {
+		surface_shm_cache_insert(surface, buffer, shm_buf);
+	}
 }
 
 static void surface_update_opaque_region(struct wlr_surface *surface) {
@@ -409,6 +579,7 @@ static void surface_commit_pending(struct wlr_surface *surface) {
 	surface_state_copy(&surface->previous, &surface->current);
 	surface_state_move(&surface->current, &surface->pending);
 
+	surface_shm_cache_add_damage(surface);
 	if (invalid_buffer) {
 		surface_apply_damage(surface);
 	}
@@ -658,6 +829,7 @@ static void surface_handle_resource_destroy(struct wl_resource *resource) {
 	pixman_region32_fini(&surface->buffer_damage);
 	pixman_region32_fini(&surface->opaque_region);
 	pixman_region32_fini(&surface->input_region);
+	surface_shm_cache_finish(surface);
 	if (surface->buffer != NULL) {
 		wlr_buffer_unlock(&surface->buffer->base);
 	}
@@ -705,6 +877,7 @@ struct wlr_surface *wlr_surface_create(struct wl_client *client,
 	pixman_region32_init(&surface->buffer_damage);
 	pixman_region32_init(&surface->opaque_region);
 	pixman_region32_init(&surface->input_region);
+	wl_list_init(&surface->shm_cache);
 
 	wl_signal_add(&renderer->events.destroy, &surface->renderer_destroy);
 	surface->renderer_destroy.notify = surface_handle_renderer_destroy;
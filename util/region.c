@@ -1,7 +1,9 @@
 #include <assert.h>
 #include <math.h>
 #include <limits.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <wlr/util/region.h>
 
 void wlr_region_scale(pixman_region32_t *dst, pixman_region32_t *src,
@@ -252,3 +254,165 @@ bool wlr_region_confine(pixman_region32_t *region, double x1, double y1, double
 		return false;
 	}
 }
+
+uint64_t wlr_region_area(pixman_region32_t *region) {
+	int nrects;
+	pixman_box32_t *rects = pixman_region32_rectangles(region, &nrects);
+
+	uint64_t area = 0;
+	for (int i = 0; i < nrects; ++i) {
+		area += (uint64_t)(rects[i].x2 - rects[i].x1) *
+			(rects[i].y2 - rects[i].y1);
+	}
+	return area;
+}
+
+static int64_t box_area(const pixman_box32_t *box) {
+	if (box->x2 <= box->x1 || box->y2 <= box->y1) {
+		return 0;
+	}
+	return (int64_t)(box->x2 - box->x1) * (box->y2 - box->y1);
+}
+
+static pixman_box32_t box_union(const pixman_box32_t *a,
+		const pixman_box32_t *b) {
+	return (pixman_box32_t){
+		.x1 = a->x1 < b->x1 ? a->x1 : b->x1,
+		.y1 = a->y1 < b->y1 ? a->y1 : b->y1,
+		.x2 = a->x2 > b->x2 ? a->x2 : b->x2,
+		.y2 = a->y2 > b->y2 ? a->y2 : b->y2,
+	};
+}
+
+static pixman_box32_t box_intersection(const pixman_box32_t *a,
+		const pixman_box32_t *b) {
+	return (pixman_box32_t){
+		.x1 = a->x1 > b->x1 ? a->x1 : b->x1,
+		.y1 = a->y1 > b->y1 ? a->y1 : b->y1,
+		.x2 = a->x2 < b->x2 ? a->x2 : b->x2,
+		.y2 = a->y2 < b->y2 ? a->y2 : b->y2,
+	};
+}
+
+/**
+ * Number of pixels added by replacing two boxes with their bounding box.
+ */
+static int64_t merge_waste(const pixman_box32_t *a, const pixman_box32_t *b) {
+	pixman_box32_t merged = box_union(a, b);
+	pixman_box32_t overlap = box_intersection(a, b);
+	return box_area(&merged) - box_area(a) - box_area(b) + box_area(&overlap);
+}
+
+static bool box_contains(const pixman_box32_t *a, const pixman_box32_t *b) {
+	return a->x1 <= b->x1 && a->y1 <= b->y1 &&
+		a->x2 >= b->x2 && a->y2 >= b->y2;
+}
+
+// Above SIMPLIFY_GRID_SIZE^2 boxes, the boxes are first merged per cell of a
+// grid of SIMPLIFY_GRID_SIZE by SIMPLIFY_GRID_SIZE cells covering the extents
+#define SIMPLIFY_GRID_SIZE 8
+
+/**
+ * Replaces the boxes with the bounding boxes of the boxes whose center falls
+ * in the same grid cell. Returns the new number of boxes.
+ */
+static int merge_grid_cells(pixman_box32_t *rects, int nrects,
+		const pixman_box32_t *extents) {
+	pixman_box32_t cells[SIMPLIFY_GRID_SIZE * SIMPLIFY_GRID_SIZE];
+	bool used[SIMPLIFY_GRID_SIZE * SIMPLIFY_GRID_SIZE] = {0};
+	int64_t width = extents->x2 - extents->x1;
+	int64_t height = extents->y2 - extents->y1;
+
+	for (int i = 0; i < nrects; ++i) {
+		int64_t cx = ((int64_t)rects[i].x1 + rects[i].x2) / 2 - extents->x1;
+		int64_t cy = ((int64_t)rects[i].y1 + rects[i].y2) / 2 - extents->y1;
+		int col = cx * SIMPLIFY_GRID_SIZE / width;
+		int row = cy * SIMPLIFY_GRID_SIZE / height;
+		if (col >= SIMPLIFY_GRID_SIZE) {
+			col = SIMPLIFY_GRID_SIZE - 1;
+		}
+		if (row >= SIMPLIFY_GRID_SIZE) {
+			row = SIMPLIFY_GRID_SIZE - 1;
+		}
+
+		int cell = row * SIMPLIFY_GRID_SIZE + col;
+		if (used[cell]) {
+			cells[cell] = box_union(&cells[cell], &rects[i]);
+		} else {
+			cells[cell] = rects[i];
+			used[cell] = true;
+		}
+	}
+
+	int n = 0;
+	for (int cell = 0; cell < SIMPLIFY_GRID_SIZE * SIMPLIFY_GRID_SIZE; ++cell) {
+		if (used[cell]) {
+			rects[n++] = cells[cell];
+		}
+	}
+	return n;
+}
+
+void wlr_region_simplify(pixman_region32_t *dst, pixman_region32_t *src,
+		int max_rects, int rect_cost) {
+	int nrects;
+	pixman_box32_t *src_rects = pixman_region32_rectangles(src, &nrects);
+	if (nrects <= 1) {
+		pixman_region32_copy(dst, src);
+		return;
+	}
+
+	pixman_box32_t *rects = malloc(nrects * sizeof(pixman_box32_t));
+	if (rects == NULL) {
+		pixman_region32_copy(dst, src);
+		return;
+	}
+	memcpy(rects, src_rects, nrects * sizeof(pixman_box32_t));
+
+	// Each merge below scans all the pairs of boxes, which is cubic overall:
+	// bound the number of boxes first, pathological regions can be made of
+	// thousands of tiny boxes
+	if (nrects > max_rects &&
+			nrects > SIMPLIFY_GRID_SIZE * SIMPLIFY_GRID_SIZE) {
+		nrects = merge_grid_cells(rects, nrects,
+			pixman_region32_extents(src));
+	}
+
+	// Greedily merge the pair of boxes wasting the fewest pixels
+	while (nrects > 1) {
+		int best_i = -1, best_j = -1;
+		int64_t best_waste = INT64_MAX;
+		for (int i = 0; i < nrects; ++i) {
+			for (int j = i + 1; j < nrects; ++j) {
+				int64_t waste = merge_waste(&rects[i], &rects[j]);
+				if (waste < best_waste) {
+					best_waste = waste;
+					best_i = i;
+					best_j = j;
+				}
+			}
+		}
+
+		if (nrects <= max_rects && best_waste > rect_cost) {
+			break;
+		}
+
+		rects[best_i] = box_union(&rects[best_i], &rects[best_j]);
+		rects[best_j] = rects[--nrects];
+
+		// Drop the boxes swallowed by the merged one
+		for (int i = 0; i < nrects; ++i) {
+			if (i != best_i && box_contains(&rects[best_i], &rects[i])) {
+				rects[i] = rects[--nrects];
+				if (best_i == nrects) {
+					best_i = i;
+				}
+				--i;
+			}
+		}
+	}
+
+	pixman_region32_fini(dst);
+	pixman_region32_init_rects(dst, rects, nrects);
+	free(rects);
+}